@@ -0,0 +1,317 @@
+// Headless frame-time benchmark. Runs each synthetic view through View()
+// on SDL's dummy video driver with the software renderer, drives it with
+// scripted input and prints per-phase percentiles as JSON.
+#include "serviettUI.h"
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <string>
+#include <vector>
+
+static std::atomic<size_t> allocations{0};
+
+void* operator new(size_t n) {
+    allocations++;
+    if (void* p = std::malloc(n ? n : 1)) return p;
+    throw std::bad_alloc();
+}
+void* operator new[](size_t n) {
+    allocations++;
+    if (void* p = std::malloc(n ? n : 1)) return p;
+    throw std::bad_alloc();
+}
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete[](void* p) noexcept { std::free(p); }
+void operator delete(void* p, size_t) noexcept { std::free(p); }
+void operator delete[](void* p, size_t) noexcept { std::free(p); }
+
+static constexpr int WINDOW_W = 400;
+static constexpr int WINDOW_H = 600;
+static constexpr int WARMUP_FRAMES = 10;
+static constexpr int MEASURED_FRAMES = 240;
+// How long the idle check watches a window, and the most frames per second
+// it may run: a focused TextField only wakes it for the caret blink.
+static constexpr Uint32 IDLE_CHECK_MS = 3000;
+static constexpr double IDLE_MAX_FPS = 10;
+
+struct Samples {
+    std::vector<double> input, build, layout, update, paint, present, total;
+    std::vector<double> allocs, textures, rasterized, textDraws;
+    std::vector<double> inputLatency;
+};
+
+struct Scenario {
+    const char* name;
+    std::function<void()> view;
+    // Runs after every frame; may push input events or navigate.
+    std::function<void(int frame)> script;
+};
+
+static void pushMouse(Uint32 type, int x, int y) {
+    SDL_Event e;
+    SDL_zero(e);
+    e.type = type;
+    e.button.button = SDL_BUTTON_LEFT;
+    e.button.x = x;
+    e.button.y = y;
+    SDL_PushEvent(&e);
+}
+
+static void click(int x, int y) {
+    pushMouse(SDL_MOUSEBUTTONDOWN, x, y);
+    pushMouse(SDL_MOUSEBUTTONUP, x, y);
+}
+
+static void pushText(const char* text) {
+    SDL_Event e;
+    SDL_zero(e);
+    e.type = SDL_TEXTINPUT;
+    std::snprintf(e.text.text, sizeof(e.text.text), "%s", text);
+    SDL_PushEvent(&e);
+}
+
+static void pushKey(SDL_Keycode key) {
+    SDL_Event e;
+    SDL_zero(e);
+    e.type = SDL_KEYDOWN;
+    e.key.keysym.sym = key;
+    SDL_PushEvent(&e);
+}
+
+static void pushWheel(int x, int y, int dy) {
+    SDL_Event e;
+    SDL_zero(e);
+    e.type = SDL_MOUSEMOTION;
+    e.motion.x = x;
+    e.motion.y = y;
+    SDL_PushEvent(&e);
+    SDL_zero(e);
+    e.type = SDL_MOUSEWHEEL;
+    e.wheel.y = dy;
+    SDL_PushEvent(&e);
+}
+
+static void quit() {
+    SDL_Event e;
+    SDL_zero(e);
+    e.type = SDL_QUIT;
+    SDL_PushEvent(&e);
+}
+
+static double percentile(std::vector<double> v, double p) {
+    if (v.empty()) return 0;
+    std::sort(v.begin(), v.end());
+    size_t i = std::min(v.size() - 1, size_t(p * v.size()));
+    return v[i];
+}
+
+static void printMetric(const char* name, const std::vector<double>& v, bool last) {
+    double sum = 0;
+    for (double x : v) sum += x;
+    std::printf("      \"%s\": {\"p50\": %.4f, \"p99\": %.4f, \"mean\": %.4f}%s\n",
+                name, percentile(v, 0.5), percentile(v, 0.99), v.empty() ? 0 : sum / v.size(), last ? "" : ",");
+}
+
+static Samples run(const Scenario& sc) {
+    Samples s;
+    int frame = 0;
+    size_t mark = allocations;
+    SetFrameCallback([&](const FrameStats& st) {
+        size_t allocs = allocations - mark;
+        if (frame >= WARMUP_FRAMES) {
+            s.input.push_back(st.input);
+            s.build.push_back(st.build);
+            s.layout.push_back(st.layout);
+            s.update.push_back(st.update);
+            s.paint.push_back(st.paint);
+            s.present.push_back(st.present);
+            s.total.push_back(st.total);
+            s.allocs.push_back(double(allocs));
+            s.textures.push_back(st.texturesCreated);
+            s.rasterized.push_back(st.textRasterized);
+            s.textDraws.push_back(st.textDrawCalls);
+            if (st.inputEvents && st.presented) s.inputLatency.push_back(st.inputLatency);
+        }
+        if (sc.script) sc.script(frame);
+        if (++frame == WARMUP_FRAMES + MEASURED_FRAMES) quit();
+        mark = allocations;
+    });
+    View(sc.view);
+    SetFrameCallback({});
+    SetPipelined(false);
+    return s;
+}
+
+static int counter = 0;
+static bool toggles[16];
+static std::string longText;
+static std::string logText;
+static TextBuffer notes;
+
+static void labelsView() {
+    for (int i = 0; i < 200; i++) Text("Label number " + std::to_string(i));
+    Text(std::to_string(counter++));
+}
+
+static void togglesView() {
+    for (int i = 0; i < 8; i++) Toggle("Toggle " + std::to_string(i), toggles[i]);
+}
+
+static void hstacksView() {
+    for (int i = 0; i < 20; i++) {
+        HStack([i]() {
+            for (int j = 0; j < 10; j++) Text(std::to_string(i * 10 + j));
+        });
+    }
+}
+
+static void textFieldView() {
+    TextField("Type something", longText);
+}
+
+static void textAreaView() {
+    TextArea(notes, 500);
+}
+
+static void logView() {
+    Paragraph(logText);
+}
+
+static void listView() {
+    List(100000, 30, 500, [](int i) {
+        Text("Row " + std::to_string(i));
+        Text(std::to_string(i * 7 % 1000));
+    });
+}
+
+// A view function that spends most of a 60 Hz frame before declaring
+// anything, like one that sorts or filters a large model.
+static void slowView() {
+    Uint64 until = SDL_GetPerformanceCounter() + SDL_GetPerformanceFrequency() * 12 / 1000;
+    while (SDL_GetPerformanceCounter() < until) {}
+    for (int i = 0; i < 40; i++) Text("Result " + std::to_string((counter + i) % 997));
+    counter++;
+}
+
+static void navigationB() {
+    Title("Second");
+    for (int i = 0; i < 10; i++) Button("Button " + std::to_string(i), []() {});
+}
+
+static void navigationC() {
+    Title("Third");
+    for (int i = 0; i < 10; i++) Text("Detail " + std::to_string(i));
+}
+
+static void navigationA() {
+    PrefetchView(navigationB);
+    Title("First");
+    for (int i = 0; i < 10; i++) Text("Row " + std::to_string(i));
+}
+
+// Frames per second of an on-demand window whose only activity is the
+// blinking caret of a focused TextField, about 2.
+static double idleFrameRate() {
+    SetRenderMode(RenderMode::OnDemand);
+    bool started = false;
+    Uint32 start = 0;
+    int frames = 0;
+    SetFrameCallback([&](const FrameStats&) {
+        Uint32 now = SDL_GetTicks();
+        if (!started) {
+            started = true;
+            start = now;
+            click(WINDOW_W / 2, WINDOW_H / 2);
+            return;
+        }
+        frames++;
+        if (now - start >= IDLE_CHECK_MS) quit();
+    });
+    View(textFieldView);
+    SetFrameCallback({});
+    SetRenderMode(RenderMode::Continuous);
+    return frames * 1000.0 / IDLE_CHECK_MS;
+}
+
+int main() {
+    SDL_setenv("SDL_VIDEODRIVER", "dummy", 1);
+    SDL_SetHint(SDL_HINT_RENDER_DRIVER, "software");
+    SetRenderMode(RenderMode::Continuous);
+    longText.assign(2000, 'x');
+    std::string note;
+    for (int i = 0; i < 5000; i++) note += "Line " + std::to_string(i) + " of a long note\n";
+    notes.setText(note);
+    notes.setCaret(note.size() / 2);
+
+    std::vector<Scenario> scenarios = {
+        {"text_labels", labelsView, {}},
+        {"toggles_animating", togglesView, [](int frame) {
+            // Sweep clicks down the switch column so some toggle is always mid-animation.
+            click(WINDOW_W - 40, (frame * 37) % WINDOW_H);
+        }},
+        {"hstacks", hstacksView, {}},
+        {"long_textfield", textFieldView, [](int frame) {
+            if (frame == 0) click(WINDOW_W / 2, WINDOW_H / 2);
+            if (frame % 2) pushText("y");
+            else pushKey(SDLK_BACKSPACE);
+        }},
+        {"textarea_5000_lines", textAreaView, [](int frame) {
+            if (frame == 0) click(WINDOW_W / 2, WINDOW_H / 2);
+            if (frame % 2) pushText("y");
+            else pushKey(SDLK_BACKSPACE);
+        }},
+        {"growing_log", logView, [](int frame) {
+            logText += "[" + std::to_string(frame) + "] worker finished a batch of jobs\n";
+        }},
+        {"list_100k_rows", listView, [](int frame) {
+            pushWheel(WINDOW_W / 2, WINDOW_H / 2, frame % 60 < 40 ? -3 : 2);
+        }},
+        {"slow_view", slowView, {}},
+        {"slow_view_pipelined", slowView, [](int frame) {
+            if (frame == 0) SetPipelined(true);
+        }},
+        {"navigation", navigationA, [](int frame) {
+            if (frame % 30 == 0) NewView(frame / 30 % 2 ? navigationA : navigationB);
+        }},
+        {"navigation_back", navigationA, [](int frame) {
+            if (frame % 30 == 0 && frame / 30 % 2) PopView();
+            else if (frame % 30 == 0) PushView(navigationB);
+        }},
+        {"navigation_two_deep", navigationA, [](int frame) {
+            // Push two views, then pop back to the first one by one.
+            if (frame % 30) return;
+            int step = frame / 30 % 4;
+            if (step == 0) PushView(navigationB);
+            else if (step == 1) PushView(navigationC);
+            else PopView();
+        }},
+    };
+
+    std::printf("{\n  \"frames\": %d,\n  \"scenarios\": [\n", MEASURED_FRAMES);
+    for (size_t i = 0; i < scenarios.size(); i++) {
+        Samples s = run(scenarios[i]);
+        std::printf("    {\n      \"name\": \"%s\",\n", scenarios[i].name);
+        printMetric("input_ms", s.input, false);
+        printMetric("build_ms", s.build, false);
+        printMetric("layout_ms", s.layout, false);
+        printMetric("update_ms", s.update, false);
+        printMetric("paint_ms", s.paint, false);
+        printMetric("present_ms", s.present, false);
+        printMetric("total_ms", s.total, false);
+        printMetric("input_latency_ms", s.inputLatency, false);
+        printMetric("allocations_per_frame", s.allocs, false);
+        printMetric("textures_created_per_frame", s.textures, false);
+        printMetric("text_rasterized_per_frame", s.rasterized, false);
+        printMetric("text_draw_calls_per_frame", s.textDraws, true);
+        std::printf("    }%s\n", i + 1 < scenarios.size() ? "," : "");
+    }
+    double idleFps = idleFrameRate();
+    std::printf("  ],\n  \"idle_focused_textfield_fps\": %.2f\n}\n", idleFps);
+    if (idleFps > IDLE_MAX_FPS) {
+        std::fprintf(stderr, "idle window ran %.1f frames/s, expected at most %.0f\n", idleFps, IDLE_MAX_FPS);
+        return 1;
+    }
+    return 0;
+}
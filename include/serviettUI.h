@@ -5,13 +5,193 @@
 #include <vector>
 #include <string>
 #include <functional>
+#include <algorithm>
+
+// Damped spring driving an animation: x'' + 2*damping*x' + stiffness*x = 0,
+// played over duration milliseconds. Damping below sqrt(stiffness) overshoots.
+struct Spring {
+    float stiffness = 64.0f;
+    float damping = 10.0f;
+    float duration = 350.0f;
+};
 
 void Text(const std::string& text);
+enum class TextAlign { Left, Center, Right };
+// Text wrapped to the width of the window, breaking lines between words and
+// at newlines, with each line aligned as align says.
+void Paragraph(const std::string& text, TextAlign align = TextAlign::Left);
 void Title(const std::string& text);
-void Button(const std::string& label, const std::function<void()>& cb);
-void Toggle(const std::string& label, bool& state);
+void Button(const std::string& label, const std::function<void()>& cb, const Spring& spring = Spring());
+void Toggle(const std::string& label, bool& state, const Spring& spring = Spring());
 void TextField(const std::string& placeholder, std::string& state);
+
+// Text edited by a TextArea. It is stored as a gap buffer with the gap at the
+// last edit. Line starts are kept on both sides of the gap too, so typing
+// and deleting cost the same however long the text is. Positions are byte
+// offsets into the UTF-8 text.
+class TextBuffer {
+public:
+    explicit TextBuffer(const std::string& text = std::string());
+    size_t size() const;
+    std::string text() const;
+    void setText(const std::string& text);
+
+    size_t caret() const { return caretPos; }
+    size_t anchor() const { return anchorPos; }
+    // Moves the caret to the character boundary at or before pos. With extend
+    // the anchor stays put, selecting the text between them.
+    void setCaret(size_t pos, bool extend = false);
+    bool hasSelection() const { return caretPos != anchorPos; }
+    size_t selectionStart() const { return std::min(caretPos, anchorPos); }
+    size_t selectionEnd() const { return std::max(caretPos, anchorPos); }
+    std::string selectedText() const;
+    // Replaces the selection, or inserts at the caret.
+    void insert(const std::string& text);
+    // Deletes the selection, or the character before the caret (after it
+    // when forward).
+    void erase(bool forward = false);
+
+    size_t lineCount() const;
+    size_t lineStart(size_t line) const;
+    // End of a line, not counting its newline.
+    size_t lineEnd(size_t line) const;
+    size_t lineOf(size_t pos) const;
+    // Replaces out with the text of a line, without its newline.
+    void line(size_t line, std::string& out) const;
+    size_t prevChar(size_t pos) const;
+    size_t nextChar(size_t pos) const;
+
+private:
+    char byteAt(size_t pos) const;
+    void moveGap(size_t pos);
+    void reserveGap(size_t bytes);
+    void eraseRange(size_t from, size_t to);
+    void copyRange(size_t from, size_t to, std::string& out) const;
+
+    std::vector<char> data;
+    size_t gapStart = 0, gapEnd = 0;
+    // Starts of lines at or before the gap, ascending, and of lines after it
+    // as distances from the end of the text, ascending (the line nearest the
+    // gap last). Neither side changes when text is edited at the gap.
+    std::vector<size_t> linesBefore, linesAfter;
+    size_t caretPos = 0, anchorPos = 0;
+};
+// Multi-line editor for buffer, height points tall. Scrolls to keep the
+// caret in view.
+void TextArea(TextBuffer& buffer, int height);
 void HStack(const std::function<void()>& cb);
-void NewView(const std::function<void()>& viewFunc);
+// Navigation stack of the window: PushView slides viewFunc in over the
+// current view, PopView slides back to the view below it, and ReplaceView
+// slides viewFunc in without keeping the current view. Call them from a
+// callback. NewView is PushView.
+void PushView(const std::function<void()>& viewFunc, const Spring& spring = Spring());
+void PopView(const Spring& spring = Spring());
+void ReplaceView(const std::function<void()>& viewFunc, const Spring& spring = Spring());
+void NewView(const std::function<void()>& viewFunc, const Spring& spring = Spring());
+// Declares, from a view function, a view likely to be pushed next. It is
+// rendered ahead while the window is idle, so pushing it shows up at once.
+void PrefetchView(void (*viewFunc)());
+// Memory kept for renderings of views on the back stack and prefetched
+// views, 32 MB by default. Least recently shown views are dropped first and
+// are rendered again when they are shown.
+void SetViewCacheBudget(size_t bytes);
 void Image(const std::string& path, int w, int h);
+// Memory kept for decoded Image textures, 64 MB by default. Least recently
+// drawn images are released first.
+void SetImageCacheBudget(size_t bytes);
+// Scrollable list of rowCount rows, rowHeight points each, in a viewport
+// height points tall. row(i) declares the content of row i, laid out like an
+// HStack, and is only called for rows in or near the viewport.
+void List(int rowCount, int rowHeight, int height, const std::function<void(int)>& row, const Spring& spring = Spring());
+// Gives the next widget declared an identity of its own. Without one, a
+// widget keeps its state across builds by the line it is declared on and
+// its order among the widgets of that line and type; give keys to widgets
+// that change order, such as the entries of a filtered or sorted list.
+void Key(const std::string& key);
+// Folder fonts and Image() files are loaded from, ./Resources (relative to
+// the working directory) by default. Set it before opening a window.
+void SetResourceRoot(const std::string& path);
+// Shows viewFunc in a window and runs until it is closed.
 void View(const std::function<void()>& viewFunc);
+
+// A window with its own view, widget state and caches. Fonts and text
+// measurements are shared by all windows of the process. Open windows are
+// driven together by RunWindows(), on the main thread.
+struct Context;
+Context* OpenWindow(const std::string& title, const std::function<void()>& viewFunc);
+// Closes a window once the pass of the loop that is running ends.
+void CloseWindow(Context* window);
+// Runs every open window from one event loop until all of them are closed.
+// NewView() and Button callbacks act on the window the input came from.
+void RunWindows();
+
+// Frame pacing while animating: a target rate (60 by default), or vsync,
+// which locks presents to the display refresh and ignores the target rate.
+void SetFrameRate(int fps);
+void SetVSync(bool enabled);
+
+// Pipelined mode runs the view function and layout for the next frame on a
+// worker thread while the UI thread paints and presents the current one, at
+// the cost of one frame of input latency. Button callbacks still run on the
+// UI thread, never at the same time as the view function.
+void SetPipelined(bool enabled);
+
+// Intervals between presented frames while the UI was animating.
+// counts[i] holds intervals in [i, i + 1) * bucketMs; the last bucket also
+// holds anything longer. A frame is missed when its interval exceeds 1.5
+// target periods. Query from the UI thread, e.g. in a frame callback.
+struct FrameHistogram {
+    double bucketMs;
+    std::vector<Uint64> counts;
+    Uint64 frames;
+    Uint64 missed;
+    double targetMs;
+    double percentile(double p) const;
+};
+FrameHistogram GetFrameHistogram();
+void ResetFrameHistogram();
+
+// OnDemand (the default) only runs a frame for input, running animations,
+// the caret blink or Invalidate(); Continuous redraws at a fixed rate.
+enum class RenderMode { OnDemand, Continuous };
+void SetRenderMode(RenderMode mode);
+// Wakes the UI loop to rebuild the view. Safe to call from any thread.
+void Invalidate();
+
+// Timings of one pass through the UI loop in milliseconds, not counting time
+// spent waiting for events or pacing frames. In pipelined mode build and
+// layout are the worker's times for the frame this pass painted.
+struct FrameStats {
+    double input = 0, build = 0, layout = 0, update = 0, paint = 0, present = 0, total = 0;
+    int texturesCreated = 0;
+    int textRasterized = 0;
+    int textDrawCalls = 0;
+    int textMeasured = 0;
+    int descriptorsBuilt = 0;
+    // Input events handled this frame, and the time from the oldest input
+    // shown by this frame to its present (0 if either is missing).
+    int inputEvents = 0;
+    double inputLatency = 0;
+    bool presented = false;
+};
+// Streaming textures that text, images and widget shapes are uploaded
+// into, recycled by size class instead of created and destroyed. hits and
+// misses count requests served by a free texture or by creating one;
+// bytesResident is the memory of all pooled textures, in use or not, and
+// bytesFree the part waiting to be reused. Summed over all windows; query
+// from the UI thread.
+struct TexturePoolStats {
+    Uint64 hits = 0, misses = 0;
+    size_t bytesResident = 0, bytesFree = 0;
+};
+TexturePoolStats GetTexturePoolStats();
+
+// Called on the UI thread at the end of every pass through the loop, once
+// per window that ran.
+void SetFrameCallback(const std::function<void(const FrameStats&)>& cb);
+
+// Writes the most recent trace spans and counters of the UI loop to path as
+// Chrome trace JSON. Setting SERVIETTUI_TRACE_FILE writes one when View()
+// returns. Returns false if the file can't be written or the library was
+// built with SERVIETTUI_TRACE=0.
+bool DumpTrace(const std::string& path);
@@ -0,0 +1,95 @@
+// animation.cpp
+#include "animation.h"
+#include <algorithm>
+
+void startTween(Animations& a, int state, TweenProp prop, float from, float to, double now, const Spring& spring) {
+    int i = findTween(a, state, prop);
+    if (i < 0) {
+        i = int(a.state.size());
+        a.state.push_back(state);
+        a.prop.push_back(prop);
+        a.start.emplace_back();
+        a.duration.emplace_back();
+        a.curve.emplace_back();
+        a.from.emplace_back();
+        a.to.emplace_back();
+        a.value.emplace_back();
+        a.done.emplace_back();
+    }
+    a.start[i] = now;
+    a.duration[i] = std::max(spring.duration, 1.0f);
+    a.curve[i] = &springCurve(spring);
+    a.from[i] = from;
+    a.to[i] = to;
+    a.value[i] = from;
+    a.done[i] = 0;
+}
+
+int findTween(const Animations& a, int state, TweenProp prop) {
+    for (size_t i = 0; i < a.state.size(); i++)
+        if (a.state[i] == state && a.prop[i] == prop) return int(i);
+    return -1;
+}
+
+void retireTween(Animations& a, size_t i) {
+    size_t last = a.state.size() - 1;
+    if (i != last) {
+        a.state[i] = a.state[last];
+        a.prop[i] = a.prop[last];
+        a.start[i] = a.start[last];
+        a.duration[i] = a.duration[last];
+        a.curve[i] = a.curve[last];
+        a.from[i] = a.from[last];
+        a.to[i] = a.to[last];
+        a.value[i] = a.value[last];
+        a.done[i] = a.done[last];
+    }
+    a.state.pop_back();
+    a.prop.pop_back();
+    a.start.pop_back();
+    a.duration.pop_back();
+    a.curve.pop_back();
+    a.from.pop_back();
+    a.to.pop_back();
+    a.value.pop_back();
+    a.done.pop_back();
+}
+
+void stopTween(Animations& a, int state, TweenProp prop) {
+    int i = findTween(a, state, prop);
+    if (i >= 0) retireTween(a, size_t(i));
+}
+
+// Samples each tween's spring curve the way springSample() does, with the
+// clamping folded into the index so the loop has no branches.
+void advanceTweens(Animations& a, double now) {
+    size_t n = a.state.size();
+    const double* start = a.start.data();
+    const float* duration = a.duration.data();
+    const SpringCurve* const* curve = a.curve.data();
+    const float* from = a.from.data();
+    const float* to = a.to.data();
+    float* value = a.value.data();
+    Uint8* done = a.done.data();
+    for (size_t i = 0; i < n; i++) {
+        float t = std::min(std::max(float(now - start[i]) / duration[i], 0.0f), 1.0f);
+        float pos = t * SPRING_SAMPLES;
+        int k = std::min(int(pos), SPRING_SAMPLES - 1);
+        float frac = pos - float(k);
+        const float* v = curve[i]->v.data();
+        value[i] = from[i] + (to[i] - from[i]) * (v[k] + (v[k + 1] - v[k]) * frac);
+        done[i] = t >= 1.0f;
+    }
+}
+
+void remapTweens(Animations& a, const std::vector<int>& moved) {
+    for (size_t i = a.state.size(); i-- > 0;) {
+        int to = size_t(a.state[i]) < moved.size() ? moved[a.state[i]] : -1;
+        if (to < 0) retireTween(a, i);
+        else a.state[i] = to;
+    }
+}
+
+void clearTweens(Animations& a) {
+    a = Animations();
+}
@@ -0,0 +1,38 @@
+// animation.h
+#pragma once
+#include "spring.h"
+#include <vector>
+
+// Widget properties driven by tweens.
+enum class TweenProp { Alpha, TogglePos, Scroll };
+
+// The running tweens of a window as parallel arrays, so a frame advances
+// all of them in one pass over contiguous data. Tween i moves property
+// prop[i] of widget state state[i] from from[i] to to[i] along curve[i],
+// starting at start[i] and lasting duration[i] ms. advanceTweens() fills
+// value[i] and sets done[i] once it has arrived.
+struct Animations {
+    std::vector<int> state;
+    std::vector<TweenProp> prop;
+    std::vector<double> start;
+    std::vector<float> duration;
+    std::vector<const SpringCurve*> curve;
+    std::vector<float> from, to, value;
+    std::vector<Uint8> done;
+};
+
+// Starts a tween, replacing the one already running on the same property.
+void startTween(Animations& a, int state, TweenProp prop, float from, float to, double now, const Spring& spring);
+// Index of the tween running on a property, or -1.
+int findTween(const Animations& a, int state, TweenProp prop);
+void stopTween(Animations& a, int state, TweenProp prop);
+// Removes tween i, moving the last one into its place.
+void retireTween(Animations& a, size_t i);
+void advanceTweens(Animations& a, double now);
+// Follows states that moved to new indices; moved[i] is the new index of
+// state i, or -1 if it is gone, which drops its tweens.
+void remapTweens(Animations& a, const std::vector<int>& moved);
+void clearTweens(Animations& a);
+inline bool tweensRunning(const Animations& a) {
+    return !a.state.empty();
+}
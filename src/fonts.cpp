@@ -0,0 +1,125 @@
+// fonts.cpp
+#include "fonts.h"
+#include "serviettUI.h"
+#include <map>
+#include <utility>
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// The bytes of a font file: a read-only mapping of it, or a copy read into
+// memory where it can't be mapped. data is null if the file can't be read.
+struct FontFile {
+    const void* data = nullptr;
+    size_t size = 0;
+    bool mapped = false;
+#ifdef _WIN32
+    HANDLE mapping = nullptr;
+#endif
+};
+
+static std::string resourceRoot = "./Resources";
+static std::map<std::string, FontFile> files;
+static std::map<std::pair<std::string, int>, TTF_Font*> sizes;
+
+static bool mapFile(const std::string& path, FontFile& f) {
+#ifdef _WIN32
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE) return false;
+    LARGE_INTEGER size;
+    if (GetFileSizeEx(file, &size) && size.QuadPart > 0) {
+        f.mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (f.mapping) f.data = MapViewOfFile(f.mapping, FILE_MAP_READ, 0, 0, 0);
+        if (f.data) f.size = size_t(size.QuadPart);
+        else if (f.mapping) CloseHandle(f.mapping);
+    }
+    CloseHandle(file);
+#else
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+    struct stat info;
+    if (fstat(fd, &info) == 0 && info.st_size > 0) {
+        void* p = mmap(nullptr, size_t(info.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+        if (p != MAP_FAILED) {
+            f.data = p;
+            f.size = size_t(info.st_size);
+        }
+    }
+    close(fd);
+#endif
+    f.mapped = f.data != nullptr;
+    return f.mapped;
+}
+
+static void readFile(const std::string& path, FontFile& f) {
+    SDL_RWops* rw = SDL_RWFromFile(path.c_str(), "rb");
+    if (!rw) return;
+    Sint64 size = SDL_RWsize(rw);
+    void* data = size > 0 ? SDL_malloc(size_t(size)) : nullptr;
+    if (data && SDL_RWread(rw, data, 1, size_t(size)) == size_t(size)) {
+        f.data = data;
+        f.size = size_t(size);
+    } else {
+        SDL_free(data);
+    }
+    SDL_RWclose(rw);
+}
+
+static void releaseFile(FontFile& f) {
+    if (!f.data) return;
+    if (!f.mapped) SDL_free(const_cast<void*>(f.data));
+#ifdef _WIN32
+    else {
+        UnmapViewOfFile(f.data);
+        CloseHandle(f.mapping);
+    }
+#else
+    else munmap(const_cast<void*>(f.data), f.size);
+#endif
+    f.data = nullptr;
+}
+
+// The bytes of a font file, loaded on first use. A file that can't be read
+// isn't tried again.
+static const FontFile& fontFile(const std::string& file) {
+    auto it = files.find(file);
+    if (it != files.end()) return it->second;
+    FontFile& f = files[file];
+    std::string path = resourcePath(file);
+    if (!mapFile(path, f)) readFile(path, f);
+    return f;
+}
+
+TTF_Font* openFont(const std::string& file, int pixels) {
+    auto key = std::make_pair(file, pixels);
+    auto it = sizes.find(key);
+    if (it != sizes.end()) return it->second;
+    const FontFile& f = fontFile(file);
+    TTF_Font* font = nullptr;
+    // The font closes its RWops; the bytes stay until closeFonts().
+    if (f.data) font = TTF_OpenFontRW(SDL_RWFromConstMem(f.data, int(f.size)), 1, pixels);
+    sizes.emplace(key, font);
+    return font;
+}
+
+void closeFonts() {
+    for (auto& s : sizes)
+        if (s.second) TTF_CloseFont(s.second);
+    sizes.clear();
+    for (auto& f : files) releaseFile(f.second);
+    files.clear();
+}
+
+std::string resourcePath(const std::string& name) {
+    return resourceRoot + "/" + name;
+}
+
+void SetResourceRoot(const std::string& path) {
+    resourceRoot = path.empty() ? "." : path;
+}
@@ -0,0 +1,14 @@
+// fonts.h
+#pragma once
+#include <SDL_ttf.h>
+#include <string>
+
+// Fonts shared by every window of the process. Each font file is
+// memory-mapped once and every size of it is opened over that mapping with
+// TTF_OpenFontRW, the first time the size is asked for, so another size or
+// style reads and copies nothing. Open and close fonts on the UI thread.
+TTF_Font* openFont(const std::string& file, int pixels);
+// Closes every font and unmaps the files.
+void closeFonts();
+// Path of a file in the folder set by SetResourceRoot().
+std::string resourcePath(const std::string& name);
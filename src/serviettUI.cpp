@@ -1,104 +1,1300 @@
 #include "serviettUI.h"
+#include "spring.h"
+#include "trace.h"
+#include "fonts.h"
+#include "animation.h"
 #include <SDL.h>
 #include <SDL_ttf.h>
-#include <SDL2/SDL2_gfxPrimitives.h>
 #include <SDL_image.h>
-#include <fstream>
 #include <string>
 #include <vector>
 #include <functional>
+#include <list>
+#include <unordered_map>
+#include <map>
+#include <deque>
+#include <tuple>
+#include <cmath>
+#include <sys/types.h>
+#include <sys/stat.h>
 
-static SDL_Window* window = nullptr;
-static SDL_Renderer* renderer = nullptr;
-static TTF_Font* font = nullptr;
-static TTF_Font* titleFont = nullptr;
-static SDL_Texture* currentTarget = nullptr;
-static SDL_Texture* nextTarget = nullptr;
-static std::vector<float> springValues;
-static constexpr int WIDTH = 400;
-static constexpr int HEIGHT = 600;
-static constexpr int SCALE = 2;
+#if SDL_VERSION_ATLEAST(2,0,18) && SDL_TTF_VERSION_ATLEAST(2,0,18)
+#define SERVIETTUI_GLYPH_ATLAS 1
+#else
+#define SERVIETTUI_GLYPH_ATLAS 0
+#endif
+
+// Address the running public widget function was called from, which tells
+// widgets declared on different lines of a view function apart.
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define CALL_SITE() size_t(_ReturnAddress())
+#else
+#define CALL_SITE() size_t(__builtin_return_address(0))
+#endif
+
+// Sizes are in points unless noted; px() converts them to device pixels
+// for the window being laid out.
+static constexpr int DEFAULT_WIDTH = 400;
+static constexpr int DEFAULT_HEIGHT = 600;
+static constexpr const char* FONT_FILE = "Inter.ttf";
+static constexpr int FONT_SIZE = 18;
+static constexpr int TITLE_FONT_SIZE = 36;
+static constexpr float BASE_DPI = 96.0f;
 static constexpr int FPS = 60;
-static constexpr int FRAME_DELAY = 1000 / FPS;
-static constexpr int SPACING = 10 * SCALE;
+static constexpr int SPACING = 10;
 static constexpr int V_PADDING = 0;
 static constexpr float PRESSED_ALPHA = 0.2f;
 static constexpr float NORMAL_ALPHA = 1.0f;
 static constexpr float OVERLAY_MAX_ALPHA = 0.6f;
-static constexpr float ANIM_DURATION = 350.0f;
-static constexpr int TF_HEIGHT = 32 * SCALE;
-static constexpr int TF_PADDING = 10 * SCALE;
-static constexpr int TF_RADIUS = 8 * SCALE;
+static constexpr int TF_HEIGHT = 32;
+static constexpr int TF_PADDING = 10;
+static constexpr int TF_RADIUS = 8;
+static constexpr float TF_TEXT_INSET = 2.5f;
+static constexpr int TF_CARET_INSET = 2;
+static constexpr int TOGGLE_W = 66;
+static constexpr int TOGGLE_H = 34;
+static constexpr int TOGGLE_INSET = 5;
 static constexpr Uint32 CURSOR_BLINK_INTERVAL = 500;
+static constexpr size_t TEXT_CACHE_BUDGET = 32 * 1024 * 1024;
+static constexpr size_t IMAGE_CACHE_BUDGET = 64 * 1024 * 1024;
+static constexpr size_t VIEW_CACHE_BUDGET = 32 * 1024 * 1024;
+static constexpr size_t TEXTURE_POOL_BUDGET = 16 * 1024 * 1024;
+static constexpr double IMAGE_WATCH_INTERVAL = 1000;
+static constexpr size_t IMAGE_UPLOAD_BUDGET = 4 * 1024 * 1024;
+static constexpr int IMAGE_DECODE_THREADS = 4;
+static constexpr int ASCII_FIRST = 32;
+static constexpr int ASCII_GLYPHS = 127 - ASCII_FIRST;
+static constexpr size_t MEASURE_MEMO_LIMIT = 4096;
+static constexpr size_t LINE_BREAK_CACHE_LIMIT = 256;
+static constexpr size_t MAX_DAMAGE_RECTS = 8;
+static constexpr int ATLAS_SIZE = 1024;
+static constexpr size_t PRIMITIVE_CACHE_LIMIT = 64;
+static constexpr int HISTOGRAM_BUCKETS = 100;
+static constexpr double HISTOGRAM_BUCKET_MS = 0.5;
+static constexpr double SPIN_MS = 1.0;
+static constexpr int LIST_OVERSCAN_ROWS = 4;
+static constexpr int SCROLL_STEP = 40;
+static constexpr int TA_INSET = 4;
+// Side of a hit grid cell, in device pixels.
+static constexpr int HIT_CELL = 100;
 
-enum class DescType { Text, Title, Button, Toggle, TextField, HStack, Image };
+enum class DescType { Text, Title, Button, Toggle, TextField, HStack, Image, List, TextArea, Paragraph, Prefetch };
+// What the view function declared. Painting only reads the descriptor, so
+// user state it shows (toggle value, field text, TextArea caret, selection
+// and lines) is copied in when the view is built and laid out.
 struct Descriptor {
     DescType type;
+    // Identity across builds: the Key() or call site and the type, numbered
+    // among the top-level descriptors sharing them in declaration order.
+    size_t id = 0;
     std::string label;
     std::function<void()> cb;
-    bool* toggleState;
-    std::string* textState;
-    int imgW;
-    int imgH;
+    bool* toggleState = nullptr;
+    std::string* textState = nullptr;
+    bool toggleValue = false;
+    std::string text;
+    int imgW = 0;
+    int imgH = 0;
+    std::vector<Descriptor> children;
+    Spring spring;
+    int rowCount = 0;
+    int rowHeight = 0;
+    int listHeight = 0;
+    std::function<void(int)> rowBuilder;
+    TextBuffer* textBuffer = nullptr;
+    TextAlign align = TextAlign::Left;
+    int firstLine = 0;
+    std::vector<std::string> lines;
+    std::vector<size_t> lineStarts;
+    size_t caret = 0, selStart = 0, selEnd = 0;
 };
+// Per-widget state, kept across builds for the descriptor with the same id.
+// animating, togAnimating and scrolling tell that a tween of the window
+// drives alpha, togPos or scrollPos.
 struct State {
+    size_t id = 0;
     bool pressed = false;
     bool animating = false;
-    Uint32 animStart = 0;
     float alpha = NORMAL_ALPHA;
     bool togPressed = false;
     bool togAnimating = false;
-    Uint32 togStart = 0;
     float togPos = 0.0f;
     bool togPending = false;
     bool togTarget = false;
-    Uint32 lastBlink = 0;
+    double lastBlink = 0;
     bool showCursor = true;
     bool tfFocused = false;
+    bool scrolling = false;
+    float scrollTo = 0.0f;
+    float scrollPos = 0.0f;
+};
+// A descriptor placed by layoutView. state indexes the view's State vector
+// for top-level descriptors and is -1 for HStack and List children. List
+// rows are clipped to the list's viewport. The visible lines of a TextArea
+// follow its node, sharing its state, with line set to the buffer line; the
+// lines of a Paragraph follow it the same way.
+struct Node {
+    const Descriptor* desc;
+    SDL_Rect rect;
+    int state;
+    bool clipped = false;
+    SDL_Rect clip = {0, 0, 0, 0};
+    int line = -1;
+};
+// What was painted for one node into currentTarget, kept to find the
+// regions that changed since the last frame.
+struct PaintRecord {
+    SDL_Rect bounds;
+    size_t signature;
+};
+// One input event, queued in arrival order. at is when it happened, on the
+// clockMs() timeline. Wheel events carry the last pointer position.
+enum class InputKind { Down, Up, Move, Wheel, Text, Key };
+struct InputEvent {
+    InputKind kind = InputKind::Move;
+    double at = 0;
+    int x = 0, y = 0;
+    int wheel = 0;
+    SDL_Keysym key = {};
+    std::string text;
 };
 
-static std::vector<Descriptor> curDesc, nxtDesc;
-static std::vector<State> curStates, nxtStates;
-static std::function<void()> curViewFunc, nxtViewFunc;
-static bool animatingOverlay = false;
-static Uint32 overlayStart = 0;
-
-static std::vector<float> loadSpring(const char* path) {
-    std::ifstream f(path);
-    std::string all, line;
-    while (std::getline(f, line)) all += line;
-    std::vector<float> v;
-    for (size_t i = 0; i < all.size();) {
-        if ((all[i] >= '0' && all[i] <= '9') || all[i]=='-' || all[i]=='.') {
-            size_t j = i;
-            while (j < all.size() && ((all[j] >= '0' && all[j] <= '9') || all[j]=='-' || all[j]=='.')) j++;
-            v.push_back(std::stof(all.substr(i, j - i)));
-            i = j;
-        } else i++;
+enum class Shape { Fill, Ring };
+
+#if SERVIETTUI_GLYPH_ATLAS
+// Glyphs are rasterized once per font into shared atlas pages and text is
+// queued as textured quads, one SDL_RenderGeometry call per page at flush.
+// Each glyph bitmap is what SDL_ttf renders for that character alone, so it
+// is placed at pen + min(0, minx), matching whole-string rendering.
+struct Glyph {
+    int page = -1;
+    SDL_Rect src = {0, 0, 0, 0};
+    int minx = 0, advance = 0;
+};
+struct GlyphSet {
+    Glyph ascii[ASCII_GLYPHS];
+    bool asciiLoaded[ASCII_GLYPHS] = {};
+    std::unordered_map<Uint32, Glyph> other;
+};
+struct AtlasPage {
+    SDL_Texture* tex = nullptr;
+    int shelfX = 0, shelfY = 0, shelfH = 0;
+    std::vector<SDL_Vertex> verts;
+    std::vector<int> indices;
+};
+// A glyph rendered on the CPU, not yet placed in the atlas. surf is ARGB, or
+// null if the glyph has no bitmap.
+struct GlyphBitmap {
+    SDL_Surface* surf = nullptr;
+    int minx = 0, advance = 0;
+};
+#endif
+// Rendered label textures, keyed by font handle (face and size), color and
+// UTF-8 text. Least recently used entries are dropped once the total texel
+// memory exceeds TEXT_CACHE_BUDGET. Without the glyph atlas all text is
+// drawn from them; with it, only text in fonts whose glyph tables don't
+// reproduce SDL_ttf's own layout, such as fonts shaped by HarfBuzz.
+struct TextKey {
+    TTF_Font* font;
+    Uint32 color;
+    std::string text;
+    bool operator==(const TextKey& o) const { return font == o.font && color == o.color && text == o.text; }
+};
+struct TextKeyHash {
+    size_t operator()(const TextKey& k) const {
+        size_t h = std::hash<std::string>()(k.text);
+        h ^= std::hash<const void*>()(k.font) + 0x9e3779b9 + (h << 6) + (h >> 2);
+        h ^= std::hash<Uint32>()(k.color) + 0x9e3779b9 + (h << 6) + (h >> 2);
+        return h;
+    }
+};
+struct TextEntry {
+    TextKey key;
+    SDL_Texture* tex;
+    int w, h;
+};
+
+// Images are decoded once per path and target size, resampled to that size
+// off the UI thread and kept as textures, least recently used first out once
+// their memory exceeds the budget. Files are checked for changes every
+// IMAGE_WATCH_INTERVAL and reloaded when their size or mtime differs.
+struct ImageKey {
+    std::string path;
+    int w, h;
+    bool operator==(const ImageKey& o) const { return w == o.w && h == o.h && path == o.path; }
+};
+struct ImageKeyHash {
+    size_t operator()(const ImageKey& k) const {
+        size_t h = std::hash<std::string>()(k.path);
+        h ^= std::hash<int>()(k.w) + 0x9e3779b9 + (h << 6) + (h >> 2);
+        h ^= std::hash<int>()(k.h) + 0x9e3779b9 + (h << 6) + (h >> 2);
+        return h;
+    }
+};
+struct ImageEntry {
+    ImageKey key;
+    SDL_Texture* tex;
+    size_t bytes;
+    bool loading;
+};
+// What a file looked like when it was last loaded, and how often it changed.
+struct ImageFile {
+    Sint64 mtime;
+    Sint64 size;
+    size_t version;
+};
+// A decode request, and its result once surf is filled in. version is the
+// file version the request was made for.
+struct ImageJob {
+    ImageKey key;
+    size_t version;
+    SDL_Surface* surf;
+};
+
+// A view rendered into a target of its own, with the paint records that
+// describe it, so showing it again only repaints what changed since.
+struct Snapshot {
+    SDL_Texture* target = nullptr;
+    std::vector<PaintRecord> records;
+    double usedAt = 0;
+};
+// A screen below the current one on the navigation stack, or a view
+// rendered ahead for PrefetchView().
+struct Screen {
+    std::function<void()> viewFunc;
+    std::vector<State> states;
+    Snapshot snapshot;
+};
+enum class NavOp { Push, Pop, Replace };
+
+// Where a Paragraph broke into lines for one font and width: line i is
+// text[starts[i], ends[i]) and widths[i] pixels wide. text is the content
+// the breaks are for; when it has only grown, the lines before the last stay
+// and wrapping resumes at the start of the last one.
+struct LineBreaks {
+    std::string text;
+    std::vector<size_t> starts, ends;
+    std::vector<int> widths;
+};
+
+// Everything one window owns: its renderer and the textures drawn with it,
+// the view and its widget state, input routing, and the worker threads that
+// build frames and decode images for it. Fonts and text measurements are
+// shared by all windows.
+struct Context {
+    SDL_Window* window = nullptr;
+    SDL_Renderer* renderer = nullptr;
+    // The target the view is painted into, and a spare one for the next
+    // transition (null while none is needed).
+    SDL_Texture* currentTarget = nullptr;
+    SDL_Texture* nextTarget = nullptr;
+    // Drawable size in device pixels, device pixels per point, and device
+    // pixels per window coordinate (what mouse positions are given in).
+    // resized is set when the window's size or display changed.
+    int width = 0, height = 0;
+    float scale = 0;
+    float density = 1;
+    bool resized = false;
+    // The shared fonts at this window's scale.
+    TTF_Font* font = nullptr;
+    TTF_Font* titleFont = nullptr;
+    // Streaming textures that text, images and shapes are uploaded into, free
+    // ones by size class and format. Textures released during a frame wait in
+    // poolRetired until it has been presented.
+    std::map<std::tuple<int, int, Uint32>, std::vector<SDL_Texture*>> poolFree;
+    std::vector<SDL_Texture*> poolRetired;
+    size_t poolFreeBytes = 0;
+    TexturePoolStats poolStats;
+    std::map<std::tuple<Shape, int, int, int>, SDL_Texture*> primitives;
+#if SERVIETTUI_GLYPH_ATLAS
+    std::unordered_map<TTF_Font*, GlyphSet> glyphSets;
+    std::vector<AtlasPage> atlasPages;
+    // Bitmaps the pipeline worker rendered ahead of the paint that needs them.
+    std::map<std::pair<TTF_Font*, Uint32>, GlyphBitmap> preparedGlyphs;
+#endif
+    std::list<TextEntry> textLru;
+    std::unordered_map<TextKey, std::list<TextEntry>::iterator, TextKeyHash> textIndex;
+    size_t textBytes = 0;
+    std::list<ImageEntry> imageLru;
+    std::unordered_map<ImageKey, std::list<ImageEntry>::iterator, ImageKeyHash> imageIndex;
+    std::unordered_map<std::string, ImageFile> imageFiles;
+    size_t imageBytes = 0;
+    double imagesCheckedAt = 0;
+    std::vector<SDL_Thread*> imageWorkers;
+    SDL_mutex* imageMutex = nullptr;
+    SDL_cond* imageWake = nullptr;
+    std::deque<ImageJob> imageQueue, imageDone;
+    bool imageWorkersQuit = false;
+
+    std::vector<Descriptor> curDesc, nxtDesc;
+    std::vector<Descriptor>* building = &curDesc;
+    // Identity Key() gave the next descriptor pushed.
+    size_t nextKey = 0;
+    bool keyed = false;
+    std::vector<Node> curNodes, nxtNodes;
+    std::vector<State> curStates, nxtStates;
+    // Line breaks of Paragraphs by descriptor id, font and width.
+    std::map<std::tuple<size_t, TTF_Font*, int>, LineBreaks> lineBreaks;
+    std::function<void()> curViewFunc, nxtViewFunc;
+    bool transitionPending = false;
+    // Tweens of the current view's widget states.
+    Animations tweens;
+    bool animatingOverlay = false;
+    Spring transitionSpring;
+    double overlayStart = 0;
+    // Screens under the current one, oldest first, and views rendered ahead.
+    // During a transition slideFrom shows the outgoing view; slideBack makes
+    // it slide off to the right, uncovering the incoming one. slideOwned
+    // tells that no snapshot keeps slideFrom, so the slide releases it when
+    // it ends.
+    std::vector<Screen> backStack;
+    std::vector<Screen> prefetched;
+    NavOp navOp = NavOp::Push;
+    SDL_Texture* slideFrom = nullptr;
+    bool slideOwned = false;
+    bool slideBack = false;
+    std::vector<PaintRecord> paintedRecords, frameRecords;
+    std::vector<SDL_Rect> damage;
+    bool redraw = true;
+    bool fullRepaint = true;
+    double lastPresentAt = -1;
+    FrameStats frameStats;
+
+    // Interactive nodes of the last layout, bucketed by the HIT_CELL grid
+    // cells their hit rects overlap, and the top-level node laid out for each
+    // state.
+    std::vector<std::vector<int>> hitCells;
+    int hitCols = 0, hitRows = 0;
+    std::vector<int> stateNodes;
+    std::vector<InputEvent> inputQueue;
+    int focusState = -1;
+    int pressedState = -1;
+    int pointerX = 0, pointerY = 0;
+    // Whether an event for this window arrived since its last frame, and
+    // whether it was asked to close.
+    bool woken = false;
+    bool closing = false;
+    // Whether the window had something to draw when the loop last waited.
+    bool busy = false;
+
+    SDL_Thread* pipelineThread = nullptr;
+    SDL_mutex* pipelineMutex = nullptr;
+    SDL_cond* pipelineWake = nullptr;
+    bool pipelineStart = false, pipelineBusy = false, pipelineQuit = false;
+    bool pipelineReady = false;
+    // Whether the worker's build moved states, and where each one went.
+    bool workMoved = false;
+    std::vector<int> workMoves;
+    std::vector<Descriptor> workDesc;
+    std::vector<Node> workNodes;
+    std::vector<State> workStates;
+    FrameStats workStats;
+    double workInputAt = -1;
+};
+
+static std::vector<Context*> contexts;
+// The window the running thread works for: set by the event loop for each
+// window in turn, and fixed on the worker threads a window starts.
+static thread_local Context* ctx = nullptr;
+// Where the work counters of the running thread go: the window's frameStats
+// on the UI thread, its workStats on the pipeline worker.
+static thread_local FrameStats* counters = nullptr;
+static RenderMode renderMode = RenderMode::OnDemand;
+static Uint32 invalidateEvent = Uint32(-1);
+static int targetFps = FPS;
+static bool vsync = false;
+static double frameNow = 0;
+static double nextDeadline = 0;
+static FrameHistogram histogram = {HISTOGRAM_BUCKET_MS, std::vector<Uint64>(HISTOGRAM_BUCKETS), 0, 0, 0};
+static std::function<void(const FrameStats&)> frameCallback;
+static size_t imageBudget = IMAGE_CACHE_BUDGET;
+static size_t viewCacheBudget = VIEW_CACHE_BUDGET;
+
+static void useContext(Context* c) {
+    ctx = c;
+    counters = c ? &c->frameStats : nullptr;
+}
+
+// Device pixels covered by a length in points, in the current window.
+static int px(float points) {
+    return int(std::lround(points * ctx->scale));
+}
+
+// Pooled textures are rounded up to size classes a quarter of a power of two
+// apart (16, 20, 24, 28, 32, 40, ...), wasting at most a fifth of a side, and
+// are drawn with a source rect covering what was uploaded.
+static int sizeClass(int n) {
+    if (n <= 16) return 16;
+    int p = 16;
+    while (p * 2 <= n) p *= 2;
+    int step = p / 4;
+    return (n + step - 1) / step * step;
+}
+
+static size_t textureBytes(SDL_Texture* tex, Uint32* format = nullptr, int* w = nullptr, int* h = nullptr) {
+    Uint32 f;
+    int tw, th;
+    SDL_QueryTexture(tex, &f, nullptr, &tw, &th);
+    if (format) *format = f;
+    if (w) *w = tw;
+    if (h) *h = th;
+    return size_t(tw) * th * SDL_BYTESPERPIXEL(f);
+}
+
+// A streaming texture of at least w x h, reused from the pool if one of its
+// size class is free. It blends, with no color or alpha mod.
+static SDL_Texture* acquireTexture(int w, int h, Uint32 format) {
+    int cw = sizeClass(w), ch = sizeClass(h);
+    std::vector<SDL_Texture*>& bucket = ctx->poolFree[std::make_tuple(cw, ch, format)];
+    SDL_Texture* tex;
+    if (!bucket.empty()) {
+        tex = bucket.back();
+        bucket.pop_back();
+        ctx->poolFreeBytes -= textureBytes(tex);
+        ctx->poolStats.hits++;
+    } else {
+        tex = SDL_CreateTexture(ctx->renderer, format, SDL_TEXTUREACCESS_STREAMING, cw, ch);
+        counters->texturesCreated++;
+        ctx->poolStats.misses++;
+        if (!tex) return nullptr;
+        ctx->poolStats.bytesResident += textureBytes(tex);
+    }
+    SDL_SetTextureBlendMode(tex, SDL_BLENDMODE_BLEND);
+    SDL_SetTextureColorMod(tex, 255, 255, 255);
+    SDL_SetTextureAlphaMod(tex, 255);
+    return tex;
+}
+
+// Hands a texture from acquireTexture() back. Draws already queued with it
+// this frame stay intact: it is only reused after the frame is presented.
+static void releaseTexture(SDL_Texture* tex) {
+    if (tex) ctx->poolRetired.push_back(tex);
+}
+
+// Makes the textures released this frame free for reuse, destroying the
+// ones that don't fit in TEXTURE_POOL_BUDGET.
+static void recycleTextures() {
+    for (SDL_Texture* tex : ctx->poolRetired) {
+        Uint32 format;
+        int w, h;
+        size_t bytes = textureBytes(tex, &format, &w, &h);
+        if (ctx->poolFreeBytes + bytes > TEXTURE_POOL_BUDGET) {
+            SDL_DestroyTexture(tex);
+            ctx->poolStats.bytesResident -= bytes;
+            continue;
+        }
+        ctx->poolFree[std::make_tuple(w, h, format)].push_back(tex);
+        ctx->poolFreeBytes += bytes;
+    }
+    ctx->poolRetired.clear();
+}
+
+static void clearTexturePool() {
+    recycleTextures();
+    for (auto& bucket : ctx->poolFree)
+        for (SDL_Texture* tex : bucket.second) SDL_DestroyTexture(tex);
+    ctx->poolFree.clear();
+    ctx->poolStats.bytesResident -= ctx->poolFreeBytes;
+    ctx->poolFreeBytes = 0;
+}
+
+// Copies a surface into a pooled texture. Returns null if that fails.
+static SDL_Texture* uploadSurface(SDL_Surface* surf) {
+    SDL_Surface* converted = nullptr;
+    if (surf->format->format != SDL_PIXELFORMAT_ARGB8888) {
+        converted = SDL_ConvertSurfaceFormat(surf, SDL_PIXELFORMAT_ARGB8888, 0);
+        if (!converted) return nullptr;
+        surf = converted;
+    }
+    SDL_Texture* tex = acquireTexture(surf->w, surf->h, SDL_PIXELFORMAT_ARGB8888);
+    if (tex) {
+        SDL_Rect r = {0, 0, surf->w, surf->h};
+        if (SDL_MUSTLOCK(surf)) SDL_LockSurface(surf);
+        SDL_UpdateTexture(tex, &r, surf->pixels, surf->pitch);
+        if (SDL_MUSTLOCK(surf)) SDL_UnlockSurface(surf);
+    }
+    if (converted) SDL_FreeSurface(converted);
+    return tex;
+}
+
+TexturePoolStats GetTexturePoolStats() {
+    TexturePoolStats total;
+    for (Context* c : contexts) {
+        total.hits += c->poolStats.hits;
+        total.misses += c->poolStats.misses;
+        total.bytesResident += c->poolStats.bytesResident;
+        total.bytesFree += c->poolFreeBytes;
+    }
+    return total;
+}
+
+// Anti-aliased widget shapes are rasterized once per size into white alpha
+// masks and tinted with color mod at draw time, instead of drawing them
+// from lines and points every frame.
+
+static void clearPrimitives() {
+    for (auto& p : ctx->primitives) releaseTexture(p.second);
+    ctx->primitives.clear();
+}
+
+// Signed distance from pixel center (x, y) to the edge of a w x h rounded
+// rectangle of corner radius r; negative inside.
+static float roundedRectDistance(float x, float y, int w, int h, int r) {
+    float qx = std::fabs(x - w * 0.5f) - (w * 0.5f - r);
+    float qy = std::fabs(y - h * 0.5f) - (h * 0.5f - r);
+    float ox = std::max(qx, 0.0f), oy = std::max(qy, 0.0f);
+    return std::sqrt(ox * ox + oy * oy) + std::min(std::max(qx, qy), 0.0f) - r;
+}
+
+static SDL_Texture* primitive(Shape shape, int w, int h, int radius) {
+    auto key = std::make_tuple(shape, w, h, radius);
+    auto it = ctx->primitives.find(key);
+    if (it != ctx->primitives.end()) return it->second;
+    if (ctx->primitives.size() >= PRIMITIVE_CACHE_LIMIT) clearPrimitives();
+    radius = std::min(radius, std::min(w, h) / 2);
+    std::vector<Uint32> pixels(size_t(w) * h);
+    for (int y = 0; y < h; y++) {
+        for (int x = 0; x < w; x++) {
+            float d = roundedRectDistance(x + 0.5f, y + 0.5f, w, h, radius);
+            float cover = std::min(std::max(0.5f - d, 0.0f), 1.0f);
+            if (shape == Shape::Ring) cover -= std::min(std::max(-0.5f - d, 0.0f), 1.0f);
+            pixels[size_t(y) * w + x] = Uint32(cover * 255 + 0.5f) << 24 | 0xFFFFFF;
+        }
+    }
+    SDL_Texture* tex = acquireTexture(w, h, SDL_PIXELFORMAT_ARGB8888);
+    SDL_Rect area = {0, 0, w, h};
+    if (tex) SDL_UpdateTexture(tex, &area, pixels.data(), w * 4);
+    ctx->primitives.emplace(key, tex);
+    return tex;
+}
+
+// Draws a filled rounded rectangle, or its one-pixel outline for Ring, in col.
+static void drawShape(Shape shape, const SDL_Rect& r, int radius, SDL_Color col) {
+    if (r.w <= 0 || r.h <= 0) return;
+    SDL_Texture* tex = primitive(shape, r.w, r.h, radius);
+    if (!tex) return;
+    SDL_SetTextureColorMod(tex, col.r, col.g, col.b);
+    SDL_SetTextureAlphaMod(tex, col.a);
+    SDL_Rect src = {0, 0, r.w, r.h};
+    SDL_RenderCopy(ctx->renderer, tex, &src, &r);
+}
+
+// Per-font glyph metrics so labels can be measured without FreeType.
+// Printable ASCII strings are summed from the advance and kerning tables;
+// anything else goes through TTF_SizeUTF8 once and is memoized. The tables
+// are checked against TTF_SizeUTF8 when built and are only used if every
+// sample matches to the pixel.
+struct GlyphMetrics {
+    int minx, maxx, advance;
+};
+struct FontMetrics {
+    int height = 0;
+    bool useTables = false;
+    GlyphMetrics glyphs[ASCII_GLYPHS];
+    std::vector<int> kerning;
+    std::unordered_map<std::string, SDL_Point> memo;
+};
+static std::unordered_map<TTF_Font*, FontMetrics> fontMetrics;
+
+// FreeType faces are not thread-safe, and fonts and their caches are shared
+// by the UI thread and the pipeline worker, so both hold fontMutex while
+// using them. SDL mutexes are recursive.
+static SDL_mutex* fontMutex = nullptr;
+struct FontLock {
+    FontLock() { SDL_LockMutex(fontMutex); }
+    ~FontLock() { SDL_UnlockMutex(fontMutex); }
+};
+
+static bool isPrintableAscii(const std::string& s) {
+    for (unsigned char c : s)
+        if (c < ASCII_FIRST || c >= ASCII_FIRST + ASCII_GLYPHS) return false;
+    return true;
+}
+
+static int tableWidth(const FontMetrics& fm, const std::string& s) {
+    int x = 0, minx = 0, maxx = 0, prev = -1;
+    for (unsigned char c : s) {
+        int g = c - ASCII_FIRST;
+        if (prev >= 0) x += fm.kerning[prev * ASCII_GLYPHS + g];
+        const GlyphMetrics& gm = fm.glyphs[g];
+        minx = std::min(minx, x + gm.minx);
+        maxx = std::max(maxx, x + std::max(gm.advance, gm.maxx));
+        x += gm.advance;
+        prev = g;
+    }
+    return maxx - minx;
+}
+
+static FontMetrics& metricsFor(TTF_Font* f) {
+    auto it = fontMetrics.find(f);
+    if (it != fontMetrics.end()) return it->second;
+    FontMetrics& fm = fontMetrics[f];
+    fm.height = TTF_FontHeight(f);
+    fm.kerning.assign(ASCII_GLYPHS * ASCII_GLYPHS, 0);
+    bool ok = true;
+    for (int g = 0; g < ASCII_GLYPHS && ok; g++) {
+        GlyphMetrics& gm = fm.glyphs[g];
+        int miny, maxy;
+#if SDL_TTF_VERSION_ATLEAST(2,0,18)
+        ok = TTF_GlyphMetrics32(f, Uint32(ASCII_FIRST + g), &gm.minx, &gm.maxx, &miny, &maxy, &gm.advance) == 0;
+#else
+        ok = TTF_GlyphMetrics(f, Uint16(ASCII_FIRST + g), &gm.minx, &gm.maxx, &miny, &maxy, &gm.advance) == 0;
+#endif
+    }
+    if (ok && TTF_GetFontKerning(f)) {
+        for (int a = 0; a < ASCII_GLYPHS; a++)
+            for (int b = 0; b < ASCII_GLYPHS; b++)
+#if SDL_TTF_VERSION_ATLEAST(2,0,18)
+                fm.kerning[a * ASCII_GLYPHS + b] = TTF_GetFontKerningSizeGlyphs32(f, Uint32(ASCII_FIRST + a), Uint32(ASCII_FIRST + b));
+#else
+                fm.kerning[a * ASCII_GLYPHS + b] = TTF_GetFontKerningSizeGlyphs(f, Uint16(ASCII_FIRST + a), Uint16(ASCII_FIRST + b));
+#endif
+    }
+    static const char* samples[] = {
+        "The quick brown fox jumps over the lazy dog",
+        "SPHINX OF BLACK QUARTZ, JUDGE MY VOW",
+        "AVAWAYATToTaTeVaVoWaWeYaYoLTPAFArTyjfij",
+        "0123456789 +-*/=()[]{}<>!?@#$%^&_~`'\"|;:,.",
+        " leading and trailing spaces ",
+    };
+    std::vector<std::string> checks;
+    for (int g = 0; g < ASCII_GLYPHS; g++) checks.push_back(std::string(1, char(ASCII_FIRST + g)));
+    for (const char* sample : samples) checks.push_back(sample);
+    for (size_t i = 0; i < checks.size() && ok; i++) {
+        int w, h;
+        TTF_SizeUTF8(f, checks[i].c_str(), &w, &h);
+        counters->textMeasured++;
+        ok = w == tableWidth(fm, checks[i]) && h == fm.height;
+    }
+    fm.useTables = ok;
+    return fm;
+}
+
+static int glyphKerning(TTF_Font* f, const FontMetrics& fm, Uint32 a, Uint32 b) {
+    Uint32 lo = Uint32(ASCII_FIRST), hi = Uint32(ASCII_FIRST + ASCII_GLYPHS);
+    if (a >= lo && a < hi && b >= lo && b < hi) return fm.kerning[(a - lo) * ASCII_GLYPHS + (b - lo)];
+#if SDL_TTF_VERSION_ATLEAST(2,0,18)
+    return TTF_GetFontKerningSizeGlyphs32(f, a, b);
+#else
+    return a <= 0xFFFF && b <= 0xFFFF ? TTF_GetFontKerningSizeGlyphs(f, Uint16(a), Uint16(b)) : 0;
+#endif
+}
+
+// Drop-in replacement for TTF_SizeUTF8 that avoids FreeType on repeat calls.
+static void measureText(TTF_Font* f, const std::string& text, int* w, int* h) {
+    FontLock lock;
+    FontMetrics& fm = metricsFor(f);
+    if (fm.useTables && isPrintableAscii(text)) {
+        *w = text.empty() ? 0 : tableWidth(fm, text);
+        *h = fm.height;
+        return;
+    }
+    auto it = fm.memo.find(text);
+    if (it == fm.memo.end()) {
+        if (fm.memo.size() >= MEASURE_MEMO_LIMIT) fm.memo.clear();
+        SDL_Point sz = {0, 0};
+        TTF_SizeUTF8(f, text.c_str(), &sz.x, &sz.y);
+        counters->textMeasured++;
+        it = fm.memo.emplace(text, sz).first;
+    }
+    *w = it->second.x;
+    *h = it->second.y;
+}
+
+static void evictText() {
+    TextEntry& e = ctx->textLru.back();
+    ctx->textBytes -= size_t(e.w) * e.h * 4;
+    releaseTexture(e.tex);
+    ctx->textIndex.erase(e.key);
+    ctx->textLru.pop_back();
+}
+
+static void clearTextCache() {
+    while (!ctx->textLru.empty()) evictText();
+}
+
+static const TextEntry* cachedText(TTF_Font* f, const std::string& text, SDL_Color col) {
+    if (text.empty()) return nullptr;
+    TextKey key{f, Uint32(col.r) << 24 | Uint32(col.g) << 16 | Uint32(col.b) << 8 | col.a, text};
+    auto it = ctx->textIndex.find(key);
+    if (it != ctx->textIndex.end()) {
+        ctx->textLru.splice(ctx->textLru.begin(), ctx->textLru, it->second);
+        return &*it->second;
+    }
+    SDL_Surface* surf;
+    {
+        TRACE_SCOPE("rasterize text");
+        FontLock lock;
+        surf = TTF_RenderUTF8_Blended(f, text.c_str(), col);
+    }
+    counters->textRasterized++;
+    if (!surf) return nullptr;
+    SDL_Texture* tex = uploadSurface(surf);
+    int w = surf->w, h = surf->h;
+    SDL_FreeSurface(surf);
+    if (!tex) return nullptr;
+    size_t bytes = size_t(w) * h * 4;
+    while (!ctx->textLru.empty() && ctx->textBytes + bytes > TEXT_CACHE_BUDGET) evictText();
+    ctx->textLru.push_front({key, tex, w, h});
+    ctx->textIndex.emplace(std::move(key), ctx->textLru.begin());
+    ctx->textBytes += bytes;
+    return &ctx->textLru.front();
+}
+
+// Draws text from a texture of the whole string, with its top-left corner
+// at (x, y); returns the drawn width.
+static int drawTextTexture(TTF_Font* f, const std::string& text, SDL_Color col, int x, int y, Uint8 alpha = 255) {
+    const TextEntry* e = cachedText(f, text, col);
+    if (!e) return 0;
+    SDL_Rect src = {0, 0, e->w, e->h};
+    SDL_Rect r = {x, y, e->w, e->h};
+    SDL_SetTextureAlphaMod(e->tex, alpha);
+    SDL_RenderCopy(ctx->renderer, e->tex, &src, &r);
+    counters->textDrawCalls++;
+    return e->w;
+}
+
+#if SERVIETTUI_GLYPH_ATLAS
+// Finds room for a w x h bitmap on a shelf of some atlas page, adding a page
+// when all are full.
+static int allocateGlyph(int w, int h, SDL_Rect& out) {
+    if (w + 1 > ATLAS_SIZE || h + 1 > ATLAS_SIZE) return -1;
+    for (size_t i = 0; i <= ctx->atlasPages.size(); i++) {
+        if (i == ctx->atlasPages.size()) {
+            AtlasPage page;
+            page.tex = SDL_CreateTexture(ctx->renderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_STATIC, ATLAS_SIZE, ATLAS_SIZE);
+            if (!page.tex) return -1;
+            counters->texturesCreated++;
+            SDL_SetTextureBlendMode(page.tex, SDL_BLENDMODE_BLEND);
+            std::vector<Uint32> clear(size_t(ATLAS_SIZE) * ATLAS_SIZE, 0);
+            SDL_UpdateTexture(page.tex, nullptr, clear.data(), ATLAS_SIZE * 4);
+            ctx->atlasPages.push_back(std::move(page));
+        }
+        AtlasPage& p = ctx->atlasPages[i];
+        if (p.shelfX + w + 1 > ATLAS_SIZE) {
+            p.shelfY += p.shelfH;
+            p.shelfX = p.shelfH = 0;
+        }
+        if (p.shelfY + h + 1 > ATLAS_SIZE) continue;
+        out = {p.shelfX, p.shelfY, w, h};
+        p.shelfX += w + 1;
+        p.shelfH = std::max(p.shelfH, h + 1);
+        return int(i);
+    }
+    return -1;
+}
+
+static GlyphBitmap rasterizeGlyph(TTF_Font* f, Uint32 cp) {
+    GlyphBitmap b;
+    int maxx, miny, maxy;
+    if (TTF_GlyphMetrics32(f, cp, &b.minx, &maxx, &miny, &maxy, &b.advance) != 0) return b;
+    TRACE_SCOPE("rasterize glyph");
+    SDL_Surface* surf = TTF_RenderGlyph32_Blended(f, cp, SDL_Color{255,255,255,255});
+    counters->textRasterized++;
+    if (!surf || surf->format->format == SDL_PIXELFORMAT_ARGB8888) {
+        b.surf = surf;
+        return b;
+    }
+    b.surf = SDL_ConvertSurfaceFormat(surf, SDL_PIXELFORMAT_ARGB8888, 0);
+    SDL_FreeSurface(surf);
+    return b;
+}
+
+static Glyph loadGlyph(TTF_Font* f, Uint32 cp) {
+    GlyphBitmap b;
+    auto it = ctx->preparedGlyphs.find({f, cp});
+    if (it != ctx->preparedGlyphs.end()) {
+        b = it->second;
+        ctx->preparedGlyphs.erase(it);
+    } else {
+        b = rasterizeGlyph(f, cp);
+    }
+    Glyph g;
+    g.minx = b.minx;
+    g.advance = b.advance;
+    if (!b.surf) return g;
+    g.page = allocateGlyph(b.surf->w, b.surf->h, g.src);
+    if (g.page >= 0) SDL_UpdateTexture(ctx->atlasPages[g.page].tex, &g.src, b.surf->pixels, b.surf->pitch);
+    SDL_FreeSurface(b.surf);
+    return g;
+}
+
+static const Glyph& glyphFor(GlyphSet& set, TTF_Font* f, Uint32 cp) {
+    if (cp >= Uint32(ASCII_FIRST) && cp < Uint32(ASCII_FIRST + ASCII_GLYPHS)) {
+        int i = int(cp) - ASCII_FIRST;
+        if (!set.asciiLoaded[i]) {
+            set.ascii[i] = loadGlyph(f, cp);
+            set.asciiLoaded[i] = true;
+        }
+        return set.ascii[i];
+    }
+    auto it = set.other.find(cp);
+    if (it == set.other.end()) it = set.other.emplace(cp, loadGlyph(f, cp)).first;
+    return it->second;
+}
+
+static Uint32 nextCodepoint(const std::string& s, size_t& i) {
+    unsigned char c = s[i++];
+    int extra = c >= 0xF0 ? 3 : c >= 0xE0 ? 2 : c >= 0xC0 ? 1 : 0;
+    Uint32 cp = extra == 3 ? c & 0x07 : extra == 2 ? c & 0x0F : extra == 1 ? c & 0x1F : c;
+    for (; extra > 0 && i < s.size() && (s[i] & 0xC0) == 0x80; extra--) cp = cp << 6 | (s[i++] & 0x3F);
+    return extra ? 0xFFFD : cp;
+}
+
+// Renders the glyphs of text that are neither in the atlas nor prepared yet,
+// so the paint that draws it only has to upload them. Only looks up
+// glyphSets; the UI thread is the only one that changes it.
+static void prepareText(TTF_Font* f, const std::string& text) {
+    FontLock lock;
+    if (!metricsFor(f).useTables) return;
+    auto set = ctx->glyphSets.find(f);
+    for (size_t i = 0; i < text.size();) {
+        Uint32 cp = nextCodepoint(text, i);
+        if (set != ctx->glyphSets.end()) {
+            if (cp >= Uint32(ASCII_FIRST) && cp < Uint32(ASCII_FIRST + ASCII_GLYPHS)) {
+                if (set->second.asciiLoaded[cp - ASCII_FIRST]) continue;
+            } else if (set->second.other.count(cp)) {
+                continue;
+            }
+        }
+        if (!ctx->preparedGlyphs.count({f, cp})) ctx->preparedGlyphs[{f, cp}] = rasterizeGlyph(f, cp);
+    }
+}
+
+static void queueGlyph(const Glyph& g, float x, float y, SDL_Color col) {
+    AtlasPage& p = ctx->atlasPages[g.page];
+    int base = int(p.verts.size());
+    float u0 = float(g.src.x) / ATLAS_SIZE, v0 = float(g.src.y) / ATLAS_SIZE;
+    float u1 = float(g.src.x + g.src.w) / ATLAS_SIZE, v1 = float(g.src.y + g.src.h) / ATLAS_SIZE;
+    float x1 = x + g.src.w, y1 = y + g.src.h;
+    p.verts.push_back({{x, y}, col, {u0, v0}});
+    p.verts.push_back({{x1, y}, col, {u1, v0}});
+    p.verts.push_back({{x1, y1}, col, {u1, v1}});
+    p.verts.push_back({{x, y1}, col, {u0, v1}});
+    const int quad[6] = {0, 1, 2, 0, 2, 3};
+    for (int k : quad) p.indices.push_back(base + k);
+}
+
+// Submits all queued text. Must run before the clip rect or render target
+// changes so queued quads are drawn under the state they were queued in.
+static void flushText() {
+    for (AtlasPage& p : ctx->atlasPages) {
+        if (p.indices.empty()) continue;
+        SDL_RenderGeometry(ctx->renderer, p.tex, p.verts.data(), int(p.verts.size()), p.indices.data(), int(p.indices.size()));
+        counters->textDrawCalls++;
+        p.verts.clear();
+        p.indices.clear();
+    }
+}
+
+static void clearGlyphAtlas() {
+    for (AtlasPage& p : ctx->atlasPages) SDL_DestroyTexture(p.tex);
+    ctx->atlasPages.clear();
+    ctx->glyphSets.clear();
+    for (auto& p : ctx->preparedGlyphs)
+        if (p.second.surf) SDL_FreeSurface(p.second.surf);
+    ctx->preparedGlyphs.clear();
+}
+
+// Queues text with its top-left corner at (x, y); returns the text width.
+static int drawText(TTF_Font* f, const std::string& text, SDL_Color col, int x, int y, Uint8 alpha = 255) {
+    if (text.empty()) return 0;
+    FontLock lock;
+    FontMetrics& fm = metricsFor(f);
+    // Glyph by glyph placement only matches the measured width when the
+    // tables agree with SDL_ttf; other fonts keep its kerning and shaping.
+    if (!fm.useTables) return drawTextTexture(f, text, col, x, y, alpha);
+    GlyphSet& set = ctx->glyphSets[f];
+    bool kerning = TTF_GetFontKerning(f) != 0;
+    col.a = Uint8(col.a * alpha / 255);
+    int pen = 0, minx = 0;
+    Uint32 prev = 0;
+    // Pass one finds how far the first glyphs reach left of the origin.
+    for (size_t i = 0; i < text.size();) {
+        Uint32 cp = nextCodepoint(text, i);
+        const Glyph& g = glyphFor(set, f, cp);
+        if (prev && kerning) pen += glyphKerning(f, fm, prev, cp);
+        minx = std::min(minx, pen + g.minx);
+        pen += g.advance;
+        prev = cp;
+    }
+    pen = 0;
+    prev = 0;
+    for (size_t i = 0; i < text.size();) {
+        Uint32 cp = nextCodepoint(text, i);
+        const Glyph& g = glyphFor(set, f, cp);
+        if (prev && kerning) pen += glyphKerning(f, fm, prev, cp);
+        if (g.page >= 0) queueGlyph(g, float(x - minx + pen + std::min(0, g.minx)), float(y), col);
+        pen += g.advance;
+        prev = cp;
+    }
+    int w, h;
+    measureText(f, text, &w, &h);
+    return w;
+}
+#else
+// Draws text with its top-left corner at (x, y); returns the drawn width.
+static int drawText(TTF_Font* f, const std::string& text, SDL_Color col, int x, int y, Uint8 alpha = 255) {
+    return drawTextTexture(f, text, col, x, y, alpha);
+}
+
+static void flushText() {}
+
+// Whole labels are cached per color at paint time, so there is nothing to
+// render ahead.
+static void prepareText(TTF_Font*, const std::string&) {}
+#endif
+
+// Drops the least recently drawn image, and stops watching its file once no
+// other size of it is cached.
+static void evictImage() {
+    ImageEntry& e = ctx->imageLru.back();
+    std::string path = e.key.path;
+    ctx->imageBytes -= e.bytes;
+    releaseTexture(e.tex);
+    ctx->imageIndex.erase(e.key);
+    ctx->imageLru.pop_back();
+    for (const ImageEntry& other : ctx->imageLru)
+        if (other.key.path == path) return;
+    ctx->imageFiles.erase(path);
+}
+
+static ImageFile statImage(const std::string& name) {
+#ifdef _WIN32
+    struct _stat64 info;
+    if (_stat64(resourcePath(name).c_str(), &info) != 0) return {0, -1, 0};
+#else
+    struct stat info;
+    if (stat(resourcePath(name).c_str(), &info) != 0) return {0, -1, 0};
+#endif
+    return {Sint64(info.st_mtime), Sint64(info.st_size), 0};
+}
+
+struct Tap {
+    int index;
+    float weight;
+};
+
+// Source pixels contributing to each of dst pixels along one axis. Shrinking
+// averages the whole footprint of a destination pixel, with partial weights
+// at its edges; enlarging interpolates between the two nearest pixels.
+static std::vector<std::vector<Tap>> resampleTaps(int src, int dst) {
+    std::vector<std::vector<Tap>> taps(dst);
+    float scale = float(src) / dst;
+    for (int d = 0; d < dst; d++) {
+        if (scale >= 1) {
+            float lo = d * scale, hi = lo + scale;
+            for (int i = int(lo); i < src && i < hi; i++) {
+                float w = std::min(hi, float(i + 1)) - std::max(lo, float(i));
+                if (w > 0) taps[d].push_back({i, w / scale});
+            }
+        } else {
+            float c = std::max((d + 0.5f) * scale - 0.5f, 0.0f);
+            int i = int(c);
+            float f = c - i;
+            taps[d].push_back({i, 1 - f});
+            taps[d].push_back({std::min(i + 1, src - 1), f});
+        }
+    }
+    return taps;
+}
+
+// Resizes a surface to w x h with premultiplied alpha, so transparent
+// pixels don't bleed dark fringes into the edges of the result.
+static SDL_Surface* resampleSurface(SDL_Surface* src, int w, int h) {
+    SDL_Surface* in = SDL_ConvertSurfaceFormat(src, SDL_PIXELFORMAT_ARGB8888, 0);
+    if (!in) return nullptr;
+    SDL_Surface* out = SDL_CreateRGBSurfaceWithFormat(0, w, h, 32, SDL_PIXELFORMAT_ARGB8888);
+    if (!out) {
+        SDL_FreeSurface(in);
+        return nullptr;
+    }
+    std::vector<std::vector<Tap>> xTaps = resampleTaps(in->w, w), yTaps = resampleTaps(in->h, h);
+    std::vector<float> rows(size_t(in->h) * w * 4, 0.0f);
+    for (int y = 0; y < in->h; y++) {
+        const Uint32* src = (const Uint32*)((const Uint8*)in->pixels + y * in->pitch);
+        float* dst = &rows[size_t(y) * w * 4];
+        for (int x = 0; x < w; x++) {
+            for (const Tap& t : xTaps[x]) {
+                Uint32 p = src[t.index];
+                float a = float(p >> 24) * t.weight;
+                dst[x * 4 + 0] += a;
+                dst[x * 4 + 1] += float(p >> 16 & 0xFF) * a;
+                dst[x * 4 + 2] += float(p >> 8 & 0xFF) * a;
+                dst[x * 4 + 3] += float(p & 0xFF) * a;
+            }
+        }
+    }
+    for (int y = 0; y < h; y++) {
+        Uint32* dst = (Uint32*)((Uint8*)out->pixels + y * out->pitch);
+        for (int x = 0; x < w; x++) {
+            float px[4] = {0, 0, 0, 0};
+            for (const Tap& t : yTaps[y])
+                for (int c = 0; c < 4; c++) px[c] += rows[(size_t(t.index) * w + x) * 4 + c] * t.weight;
+            Uint32 a = Uint32(std::min(px[0] + 0.5f, 255.0f)), p = a << 24;
+            if (px[0] > 0)
+                for (int c = 1; c < 4; c++) p |= Uint32(std::min(px[c] / px[0] + 0.5f, 255.0f)) << (24 - 8 * c);
+            dst[x] = p;
+        }
+    }
+    SDL_FreeSurface(in);
+    return out;
+}
+
+// Decodes and resamples a file. Touches no renderer state, so it runs on the
+// decode threads.
+static SDL_Surface* decodeImage(const std::string& name, int w, int h) {
+    SDL_Surface* surf;
+    {
+        TRACE_SCOPE("decode image");
+        surf = IMG_Load(resourcePath(name).c_str());
+    }
+    if (!surf || (surf->w == w && surf->h == h)) return surf;
+    TRACE_SCOPE("resample image");
+    SDL_Surface* scaled = resampleSurface(surf, w, h);
+    SDL_FreeSurface(surf);
+    return scaled;
+}
+
+// Images are decoded on a small pool of threads. Requests and results are
+// queued under imageMutex; the UI thread uploads results as textures in
+// uploadImages(). version is the file version the request was made for, so
+// results for a file that changed in the meantime are dropped.
+
+// Wakes one window, or every window when windowID is 0. Safe to call from
+// any thread.
+static void wakeWindow(Uint32 windowID) {
+    if (invalidateEvent == Uint32(-1)) return;
+    SDL_Event e;
+    SDL_zero(e);
+    e.type = invalidateEvent;
+    e.user.windowID = windowID;
+    SDL_PushEvent(&e);
+}
+
+static int imageWorker(void* owner) {
+    ctx = static_cast<Context*>(owner);
+    Uint32 windowID = SDL_GetWindowID(ctx->window);
+    SDL_LockMutex(ctx->imageMutex);
+    for (;;) {
+        while (!ctx->imageWorkersQuit && ctx->imageQueue.empty()) SDL_CondWait(ctx->imageWake, ctx->imageMutex);
+        if (ctx->imageWorkersQuit) break;
+        ImageJob job = std::move(ctx->imageQueue.front());
+        ctx->imageQueue.pop_front();
+        SDL_UnlockMutex(ctx->imageMutex);
+        job.surf = decodeImage(job.key.path, job.key.w, job.key.h);
+        SDL_LockMutex(ctx->imageMutex);
+        ctx->imageDone.push_back(std::move(job));
+        wakeWindow(windowID);
+    }
+    SDL_UnlockMutex(ctx->imageMutex);
+    return 0;
+}
+
+static void startImageWorkers() {
+    ctx->imageMutex = SDL_CreateMutex();
+    ctx->imageWake = SDL_CreateCond();
+    ctx->imageWorkersQuit = false;
+    int count = std::min(std::max(SDL_GetCPUCount() - 1, 1), IMAGE_DECODE_THREADS);
+    for (int i = 0; i < count; i++)
+        if (SDL_Thread* t = SDL_CreateThread(imageWorker, "image decode", ctx)) ctx->imageWorkers.push_back(t);
+}
+
+static void stopImageWorkers() {
+    if (!ctx->imageMutex) return;
+    SDL_LockMutex(ctx->imageMutex);
+    ctx->imageWorkersQuit = true;
+    SDL_CondBroadcast(ctx->imageWake);
+    SDL_UnlockMutex(ctx->imageMutex);
+    for (SDL_Thread* t : ctx->imageWorkers) SDL_WaitThread(t, nullptr);
+    ctx->imageWorkers.clear();
+    ctx->imageQueue.clear();
+    for (ImageJob& job : ctx->imageDone)
+        if (job.surf) SDL_FreeSurface(job.surf);
+    ctx->imageDone.clear();
+    SDL_DestroyCond(ctx->imageWake);
+    SDL_DestroyMutex(ctx->imageMutex);
+    ctx->imageWake = nullptr;
+    ctx->imageMutex = nullptr;
+}
+
+static size_t imageVersion(const std::string& name) {
+    auto it = ctx->imageFiles.find(name);
+    return it == ctx->imageFiles.end() ? 0 : it->second.version;
+}
+
+static void clearImageCache() {
+    stopImageWorkers();
+    while (!ctx->imageLru.empty()) evictImage();
+    ctx->imageFiles.clear();
+}
+
+// Cache entry of name at w x h pixels, or nullptr for an empty size. A new
+// entry starts out loading and has no texture until uploadImages() fills it
+// in; failed loads keep a null texture, so a missing file is only retried
+// once it changes.
+static const ImageEntry* cachedImage(const std::string& name, int w, int h) {
+    if (w <= 0 || h <= 0) return nullptr;
+    ImageKey key{name, w, h};
+    auto it = ctx->imageIndex.find(key);
+    if (it != ctx->imageIndex.end()) {
+        ctx->imageLru.splice(ctx->imageLru.begin(), ctx->imageLru, it->second);
+        return &*it->second;
+    }
+    if (!ctx->imageFiles.count(name)) ctx->imageFiles[name] = statImage(name);
+    if (!ctx->imageMutex) startImageWorkers();
+    SDL_LockMutex(ctx->imageMutex);
+    ctx->imageQueue.push_back({key, imageVersion(name), nullptr});
+    SDL_CondSignal(ctx->imageWake);
+    SDL_UnlockMutex(ctx->imageMutex);
+    ctx->imageLru.push_front({key, nullptr, 0, true});
+    ctx->imageIndex.emplace(std::move(key), ctx->imageLru.begin());
+    return &ctx->imageLru.front();
+}
+
+static bool imageReady(const std::string& name, int w, int h) {
+    auto it = ctx->imageIndex.find(ImageKey{name, w, h});
+    return it != ctx->imageIndex.end() && !it->second->loading;
+}
+
+// Uploads decoded images as textures, up to IMAGE_UPLOAD_BUDGET bytes per
+// frame but always at least one, so a screen of images streams in over a
+// few frames instead of stalling one. Returns whether any are still waiting.
+static bool uploadImages() {
+    if (!ctx->imageMutex) return false;
+    size_t uploaded = 0;
+    for (;;) {
+        SDL_LockMutex(ctx->imageMutex);
+        bool more = !ctx->imageDone.empty();
+        size_t bytes = more ? size_t(ctx->imageDone.front().key.w) * ctx->imageDone.front().key.h * 4 : 0;
+        if (!more || (uploaded > 0 && uploaded + bytes > IMAGE_UPLOAD_BUDGET)) {
+            SDL_UnlockMutex(ctx->imageMutex);
+            return more;
+        }
+        ImageJob job = std::move(ctx->imageDone.front());
+        ctx->imageDone.pop_front();
+        SDL_UnlockMutex(ctx->imageMutex);
+        auto it = ctx->imageIndex.find(job.key);
+        if (it == ctx->imageIndex.end() || !it->second->loading || job.version != imageVersion(job.key.path)) {
+            if (job.surf) SDL_FreeSurface(job.surf);
+            continue;
+        }
+        ImageEntry& e = *it->second;
+        e.loading = false;
+        if (!job.surf) continue;
+        TRACE_SCOPE("upload texture");
+        e.tex = uploadSurface(job.surf);
+        SDL_FreeSurface(job.surf);
+        if (!e.tex) continue;
+        e.bytes = bytes;
+        ctx->imageBytes += bytes;
+        uploaded += bytes;
+        while (ctx->imageBytes > imageBudget && &ctx->imageLru.back() != &e) evictImage();
     }
-    return v;
+}
+
+static bool showsImages(const std::vector<Node>& nodes) {
+    for (const Node& n : nodes)
+        if (n.desc->type == DescType::Image) return true;
+    return false;
+}
+
+// Drops every cached size of files that changed on disk since they were
+// loaded and bumps their version, which changes the paint signature of the
+// Image nodes showing them. Files are only watched while the view shows
+// an Image.
+static void checkImageFiles(const std::vector<Node>& nodes, double now) {
+    if (now - ctx->imagesCheckedAt < IMAGE_WATCH_INTERVAL || !showsImages(nodes)) return;
+    ctx->imagesCheckedAt = now;
+    for (auto& [name, file] : ctx->imageFiles) {
+        ImageFile current = statImage(name);
+        if (current.mtime == file.mtime && current.size == file.size) continue;
+        current.version = file.version + 1;
+        file = current;
+        for (auto it = ctx->imageLru.begin(); it != ctx->imageLru.end();) {
+            auto next = std::next(it);
+            if (it->key.path == name) {
+                ctx->imageBytes -= it->bytes;
+                releaseTexture(it->tex);
+                ctx->imageIndex.erase(it->key);
+                ctx->imageLru.erase(it);
+            }
+            it = next;
+        }
+    }
+}
+
+static void hashMix(size_t& h, size_t v) {
+    h ^= v + 0x9e3779b9 + (h << 6) + (h >> 2);
+}
+
+static Descriptor& push(DescType type, const std::string& label, size_t site) {
+    ctx->building->emplace_back();
+    Descriptor& d = ctx->building->back();
+    d.type = type;
+    d.id = ctx->keyed ? ctx->nextKey : site;
+    hashMix(d.id, size_t(type));
+    ctx->keyed = false;
+    d.label = label;
+    counters->descriptorsBuilt++;
+    return d;
+}
+
+void Key(const std::string& key) {
+    ctx->nextKey = std::hash<std::string>()(key);
+    ctx->keyed = true;
 }
 
 void Text(const std::string& text) {
-    curDesc.push_back({DescType::Text, text, {}, nullptr, nullptr, 0, 0});
+    push(DescType::Text, text, CALL_SITE());
+}
+void Paragraph(const std::string& text, TextAlign align) {
+    Descriptor& d = push(DescType::Paragraph, text, CALL_SITE());
+    d.align = align;
 }
 void Title(const std::string& text) {
-    curDesc.push_back({DescType::Title, text, {}, nullptr, nullptr, 0, 0});
+    push(DescType::Title, text, CALL_SITE());
 }
-void Button(const std::string& label, const std::function<void()>& cb) {
-    curDesc.push_back({DescType::Button, label, cb, nullptr, nullptr, 0, 0});
+void Button(const std::string& label, const std::function<void()>& cb, const Spring& spring) {
+    Descriptor& d = push(DescType::Button, label, CALL_SITE());
+    d.cb = cb;
+    d.spring = spring;
 }
-void Toggle(const std::string& label, bool& state) {
-    curDesc.push_back({DescType::Toggle, label, {}, &state, nullptr, 0, 0});
+void Toggle(const std::string& label, bool& state, const Spring& spring) {
+    Descriptor& d = push(DescType::Toggle, label, CALL_SITE());
+    d.toggleState = &state;
+    d.toggleValue = state;
+    d.spring = spring;
 }
 void TextField(const std::string& placeholder, std::string& state) {
-    curDesc.push_back({DescType::TextField, placeholder, {}, nullptr, &state, 0, 0});
+    Descriptor& d = push(DescType::TextField, placeholder, CALL_SITE());
+    d.textState = &state;
+    d.text = state;
+}
+void TextArea(TextBuffer& buffer, int height) {
+    Descriptor& d = push(DescType::TextArea, {}, CALL_SITE());
+    d.textBuffer = &buffer;
+    d.listHeight = px(float(std::max(height, 0)));
 }
 void HStack(const std::function<void()>& cb) {
-    curDesc.push_back({DescType::HStack, {}, cb, nullptr, nullptr, 0, 0});
+    std::vector<Descriptor>* parent = ctx->building;
+    ctx->building = &push(DescType::HStack, {}, CALL_SITE()).children;
+    cb();
+    ctx->building = parent;
 }
 void Image(const std::string& path, int w, int h) {
-    curDesc.push_back({DescType::Image, path, {}, nullptr, nullptr, w, h});
+    Descriptor& d = push(DescType::Image, path, CALL_SITE());
+    d.imgW = w;
+    d.imgH = h;
+}
+void List(int rowCount, int rowHeight, int height, const std::function<void(int)>& row, const Spring& spring) {
+    Descriptor& d = push(DescType::List, {}, CALL_SITE());
+    d.rowCount = std::max(rowCount, 0);
+    d.rowHeight = std::max(px(float(rowHeight)), 1);
+    d.listHeight = px(float(std::max(height, 0)));
+    d.rowBuilder = row;
+    d.spring = spring;
 }
 
 static void eraseLastUtf8Char(std::string& s) {
@@ -108,534 +1304,1672 @@ static void eraseLastUtf8Char(std::string& s) {
     s.erase(i);
 }
 
-void NewView(const std::function<void()>& viewFunc) {
-    if (animatingOverlay) return;
-    nxtViewFunc = viewFunc;
-    nxtDesc.clear();
-    nxtViewFunc();
-    if (nxtStates.size() != nxtDesc.size()) nxtStates.assign(nxtDesc.size(), State());
-    SDL_SetRenderTarget(renderer, nextTarget);
-    SDL_SetRenderDrawColor(renderer, 255,255,255,255);
-    SDL_RenderClear(renderer);
-
-    int m = nxtDesc.size();
-    std::vector<SDL_Texture*> tex(m);
-    std::vector<SDL_Rect> rect(m);
-    std::vector<std::vector<Descriptor>> hchildren(m);
-    int totalH = 0;
-    for (int i = 0; i < m; i++) {
-        if (nxtDesc[i].type == DescType::Toggle) {
-            totalH += 68 + 2 * V_PADDING + (i ? SPACING : 0);
-        } else if (nxtDesc[i].type == DescType::TextField) {
-            totalH += TF_HEIGHT + (i ? SPACING : 0);
-        } else if (nxtDesc[i].type == DescType::HStack) {
-            std::vector<Descriptor> tmp;
-            auto save = curDesc; curDesc.clear();
-            nxtDesc[i].cb();
-            tmp = curDesc;
-            curDesc = save;
-            int maxh = 0;
-            for (auto& d : tmp) {
-                int w,h;
-                if (d.type==DescType::Text||d.type==DescType::Button||d.type==DescType::Title)
-                    TTF_SizeUTF8(d.type==DescType::Title?titleFont:font, d.label.c_str(), &w,&h),
-                    maxh = std::max(maxh, h);
-            }
-            totalH += maxh + (i?SPACING:0);
-        } else if (nxtDesc[i].type == DescType::Image) {
-            totalH += nxtDesc[i].imgH + (i ? SPACING : 0);
-        } else if (nxtDesc[i].type == DescType::Title) {
+// Numbers the top-level descriptors that share a key or call site and a
+// type, e.g. the Texts of a loop, in declaration order, completing their ids.
+static void numberDescriptors(std::vector<Descriptor>& desc) {
+    static thread_local std::vector<std::pair<size_t, size_t>> order;
+    order.clear();
+    for (size_t i = 0; i < desc.size(); i++) order.push_back({desc[i].id, i});
+    std::sort(order.begin(), order.end());
+    size_t n = 0;
+    for (size_t i = 0; i < order.size(); i++) {
+        n = i && order[i].first == order[i - 1].first ? n + 1 : 0;
+        hashMix(desc[order[i].second].id, n);
+    }
+}
+
+// Matches the states of the last build to the descriptors of this one by
+// id, so a widget keeps its animation, focus and scroll state when widgets
+// before it come and go. moved, if given, receives the new index of every
+// old state, or -1 if its widget is gone. Returns whether any state moved,
+// appeared or went away.
+static bool reconcileStates(const std::vector<Descriptor>& desc, std::vector<State>& states, std::vector<int>* moved) {
+    bool same = states.size() == desc.size();
+    for (size_t i = 0; same && i < desc.size(); i++) same = states[i].id == desc[i].id;
+    if (same) return false;
+    TRACE_SCOPE("reconcile");
+    static thread_local std::vector<std::pair<size_t, int>> old;
+    old.clear();
+    for (size_t j = 0; j < states.size(); j++) old.push_back({states[j].id, int(j)});
+    std::sort(old.begin(), old.end());
+    if (moved) moved->assign(states.size(), -1);
+    std::vector<State> next(desc.size());
+    for (size_t i = 0; i < desc.size(); i++) {
+        auto it = std::lower_bound(old.begin(), old.end(), std::make_pair(desc[i].id, -1));
+        if (it != old.end() && it->first == desc[i].id) {
+            next[i] = states[it->second];
+            if (moved) (*moved)[it->second] = int(i);
+        }
+        next[i].id = desc[i].id;
+    }
+    states.swap(next);
+    return true;
+}
+
+// Runs a view function into desc and carries states over to it. Returns
+// whether states moved, filling moved as reconcileStates() does.
+static bool buildView(const std::function<void()>& viewFunc, std::vector<Descriptor>& desc, std::vector<State>& states, std::vector<int>* moved = nullptr) {
+    TRACE_SCOPE("build");
+    desc.clear();
+    ctx->building = &desc;
+    ctx->keyed = false;
+    viewFunc();
+    ctx->building = &ctx->curDesc;
+    numberDescriptors(desc);
+    return reconcileStates(desc, states, moved);
+}
+
+// Milliseconds since mark, which is then moved to now.
+static double lapMs(Uint64& mark) {
+    Uint64 now = SDL_GetPerformanceCounter();
+    double ms = double(now - mark) * 1000.0 / double(SDL_GetPerformanceFrequency());
+    mark = now;
+    return ms;
+}
+
+// Milliseconds on the performance counter clock.
+static double clockMs() {
+    static const Uint64 origin = SDL_GetPerformanceCounter();
+    return double(SDL_GetPerformanceCounter() - origin) * 1000.0 / double(SDL_GetPerformanceFrequency());
+}
+
+static double framePeriod() {
+    return 1000.0 / targetFps;
+}
+
+// Adds the interval since the previous present to the histogram. Intervals
+// that include an idle wait say nothing about pacing and are not counted.
+static void recordPresent(double now, bool continuous) {
+    if (continuous && ctx->lastPresentAt >= 0) {
+        double interval = now - ctx->lastPresentAt;
+        int bucket = std::min(int(interval / HISTOGRAM_BUCKET_MS), HISTOGRAM_BUCKETS - 1);
+        histogram.counts[bucket]++;
+        histogram.frames++;
+        if (interval > framePeriod() * 1.5) histogram.missed++;
+    }
+    ctx->lastPresentAt = now;
+}
+
+// Sleeps until the next frame deadline. Deadlines advance by whole periods
+// so pacing does not drift, and resynchronize after a stall instead of
+// rushing frames to catch up. The last SPIN_MS is busy-waited because
+// SDL_Delay only has millisecond granularity. A vsynced present has already
+// waited for the display, so there is nothing left to do.
+static void waitForNextFrame(bool presented) {
+    double now = clockMs();
+    if (vsync && presented) {
+        nextDeadline = now;
+        return;
+    }
+    double period = framePeriod();
+    nextDeadline += period;
+    if (nextDeadline < now - period) nextDeadline = now;
+    double remaining = nextDeadline - now;
+    if (remaining > SPIN_MS) SDL_Delay(Uint32(remaining - SPIN_MS));
+    while (clockMs() < nextDeadline) {}
+}
+
+static bool isTextType(DescType t) {
+    return t == DescType::Text || t == DescType::Button || t == DescType::Title;
+}
+
+static bool inRect(int x, int y, const SDL_Rect& r) {
+    return x >= r.x && x <= r.x + r.w && y >= r.y && y <= r.y + r.h;
+}
+
+static SDL_Rect toggleSwitchRect(const SDL_Rect& row) {
+    return {ctx->width - px(TOGGLE_INSET) - px(TOGGLE_W), row.y + px(V_PADDING), px(TOGGLE_W), px(TOGGLE_H)};
+}
+
+static int maxScroll(const Descriptor& list) {
+    return std::max(0, list.rowCount * list.rowHeight - list.listHeight);
+}
+
+// Current scroll offset of a list, kept within its content.
+static float scrollOffset(const Descriptor& list, State& st) {
+    float limit = float(maxScroll(list));
+    st.scrollTo = std::min(std::max(st.scrollTo, 0.0f), limit);
+    if (!st.scrolling) st.scrollPos = st.scrollTo;
+    return std::min(std::max(st.scrollPos, 0.0f), limit);
+}
+
+// Appends nodes for the text children of a row, in equal-width slots,
+// vertically centered in rowH or, if rowH is 0, on the tallest child. Child
+// rects are relative to the row's parent and offset by top. Returns the row
+// height.
+static int layoutRow(const std::vector<Descriptor>& children, int top, int rowH, std::vector<Node>& nodes, const SDL_Rect* clip) {
+    if (children.empty()) return rowH;
+    size_t first = nodes.size();
+    int slotW = ctx->width / int(children.size());
+    int height = rowH;
+    for (size_t j = 0; j < children.size(); j++) {
+        const Descriptor& c = children[j];
+        if (!isTextType(c.type)) continue;
+        int w, h;
+        measureText(c.type == DescType::Title ? ctx->titleFont : ctx->font, c.label, &w, &h);
+        nodes.push_back({&c, {int(j) * slotW + (slotW - w) / 2, top, w, h}, -1});
+        if (clip) {
+            nodes.back().clipped = true;
+            nodes.back().clip = *clip;
+        }
+        if (!rowH) height = std::max(height, h);
+    }
+    for (size_t k = first; k < nodes.size(); k++) nodes[k].rect.y += (height - nodes[k].rect.h) / 2;
+    return height;
+}
+
+// Builds the rows of a list that fall inside its viewport plus
+// LIST_OVERSCAN_ROWS on either side, and appends their nodes. Each built row
+// is kept as an HStack child of the list so its descriptors outlive the
+// frame's nodes.
+static void layoutList(Descriptor& list, State& st, std::vector<Node>& nodes) {
+    list.children.clear();
+    if (!list.rowCount || !list.rowBuilder) return;
+    int offset = int(scrollOffset(list, st));
+    int first = std::max(0, offset / list.rowHeight - LIST_OVERSCAN_ROWS);
+    int last = std::min(list.rowCount, (offset + list.listHeight) / list.rowHeight + 1 + LIST_OVERSCAN_ROWS);
+    list.children.resize(last - first);
+    std::vector<Descriptor>* parent = ctx->building;
+    for (int i = first; i < last; i++) {
+        Descriptor& row = list.children[i - first];
+        row.type = DescType::HStack;
+        ctx->building = &row.children;
+        list.rowBuilder(i);
+    }
+    ctx->building = parent;
+    SDL_Rect clip = {0, 0, ctx->width, list.listHeight};
+    for (int i = first; i < last; i++)
+        layoutRow(list.children[i - first].children, i * list.rowHeight - offset, list.rowHeight, nodes, &clip);
+}
+
+// Width of the first bytes of a line of body text.
+static int prefixWidth(const std::string& line, size_t bytes) {
+    if (bytes == 0) return 0;
+    int w, h;
+    measureText(ctx->font, line.substr(0, bytes), &w, &h);
+    return w;
+}
+
+// Character boundary in a line of body text nearest to x.
+static size_t offsetAtX(const std::string& line, int x) {
+    size_t best = 0;
+    int bestDist = std::abs(x);
+    for (size_t i = 0; i < line.size();) {
+        i++;
+        while (i < line.size() && (line[i] & 0xC0) == 0x80) i++;
+        int dist = std::abs(prefixWidth(line, i) - x);
+        if (dist > bestDist) break;
+        best = i;
+        bestDist = dist;
+    }
+    return best;
+}
+
+static SDL_Rect textAreaInner(const SDL_Rect& r) {
+    int inset = px(TA_INSET);
+    return {r.x + inset, r.y + inset, r.w - 2 * inset, r.h - 2 * inset};
+}
+
+// Scrolls a TextArea so its caret line is visible, copies out the lines in
+// its viewport with the caret and selection and appends a node for each
+// line, clipped to the inner area.
+static void layoutTextArea(Descriptor& area, const SDL_Rect& r, State& st, int state, std::vector<Node>& nodes) {
+    const TextBuffer& buf = *area.textBuffer;
+    int lineH = TTF_FontHeight(ctx->font);
+    SDL_Rect inner = textAreaInner(r);
+    float caretTop = float(buf.lineOf(buf.caret()) * lineH);
+    float limit = float(std::max(0, int(buf.lineCount()) * lineH - inner.h));
+    st.scrollPos = std::max(std::min(st.scrollPos, caretTop), caretTop + lineH - inner.h);
+    st.scrollPos = std::min(std::max(st.scrollPos, 0.0f), limit);
+    int offset = int(st.scrollPos);
+    size_t first = size_t(offset / lineH);
+    size_t last = std::min(buf.lineCount(), size_t((offset + inner.h) / lineH + 1));
+    area.firstLine = int(first);
+    area.lines.resize(last - first);
+    area.lineStarts.resize(last - first);
+    area.caret = buf.caret();
+    area.selStart = buf.selectionStart();
+    area.selEnd = buf.selectionEnd();
+    for (size_t i = first; i < last; i++) {
+        buf.line(i, area.lines[i - first]);
+        area.lineStarts[i - first] = buf.lineStart(i);
+        Node n = {&area, {inner.x, inner.y + int(i) * lineH - offset, inner.w, lineH}, state};
+        n.clipped = true;
+        n.clip = inner;
+        n.line = int(i);
+        nodes.push_back(n);
+    }
+}
+
+// Breaks text from from on into lines at most width pixels wide, appending
+// them to lb. A line ends at a newline or before the first word that doesn't
+// fit, and spaces between wrapped lines are dropped. A word wider than a
+// whole line is broken between characters.
+static void wrapLines(TTF_Font* f, const std::string& text, size_t from, int width, LineBreaks& lb) {
+    size_t start = from;
+    for (;;) {
+        size_t hard = std::min(text.find('\n', start), text.size());
+        size_t end = start;
+        int endW = 0;
+        while (end < hard) {
+            size_t next = end;
+            while (next < hard && text[next] == ' ') next++;
+            while (next < hard && text[next] != ' ') next++;
             int w, h;
-            TTF_SizeUTF8(titleFont, nxtDesc[i].label.c_str(), &w, &h);
-            totalH += h + (i ? SPACING : 0);
-        } else {
-            int w,h;
-            TTF_SizeUTF8(font, nxtDesc[i].label.c_str(), &w, &h);
-            totalH += h + (i ? SPACING : 0);
-        }
-    }
-    int y = (HEIGHT * SCALE - totalH) / 2;
-    for (int i = 0; i < m; i++) {
-        if (nxtDesc[i].type == DescType::Toggle) {
-            rect[i] = {0, y, WIDTH * SCALE, 68 + 2 * V_PADDING};
-            y += 68 + 2 * V_PADDING + SPACING;
-        } else if (nxtDesc[i].type == DescType::TextField) {
-            rect[i] = {TF_PADDING, y, WIDTH * SCALE - 2 * TF_PADDING, TF_HEIGHT};
-            y += TF_HEIGHT + SPACING;
-        } else if (nxtDesc[i].type == DescType::HStack) {
-            int height = 0;
-            std::vector<Descriptor> tmp;
-            auto save = curDesc; curDesc.clear();
-            nxtDesc[i].cb();
-            tmp = curDesc;
-            curDesc = save;
-            for (auto& d : tmp) {
-                int w,h;
-                if (d.type==DescType::Text||d.type==DescType::Button||d.type==DescType::Title)
-                    TTF_SizeUTF8(d.type==DescType::Title?titleFont:font, d.label.c_str(), &w,&h),
-                    height = std::max(height, h);
-            }
-            rect[i] = {0, y, WIDTH * SCALE, height};
-            y += height + SPACING;
-        } else if (nxtDesc[i].type == DescType::Image) {
-            rect[i] = {(WIDTH * SCALE - nxtDesc[i].imgW) / 2, y, nxtDesc[i].imgW, nxtDesc[i].imgH};
-            y += nxtDesc[i].imgH + SPACING;
-        } else if (nxtDesc[i].type == DescType::Title) {
-            int w,h;
-            TTF_SizeUTF8(titleFont, nxtDesc[i].label.c_str(), &w, &h);
-            rect[i] = {(WIDTH * SCALE - w) / 2, y, w, h};
-            y += h + SPACING;
-        } else {
-            int w,h;
-            TTF_SizeUTF8(font, nxtDesc[i].label.c_str(), &w, &h);
-            rect[i] = {(WIDTH * SCALE - w) / 2, y, w, h};
-            y += h + SPACING;
-        }
-    }
-    for (int i = 0; i < m; i++) {
-        State& st = nxtStates[i];
-        if (nxtDesc[i].type == DescType::Button) {
-            SDL_Color col = {0,102,255,255};
-            SDL_Surface* surf = TTF_RenderUTF8_Blended(font, nxtDesc[i].label.c_str(), col);
-            tex[i] = SDL_CreateTextureFromSurface(renderer, surf);
-            SDL_FreeSurface(surf);
-            SDL_SetTextureAlphaMod(tex[i], Uint8(st.alpha * 255));
-            SDL_RenderCopy(renderer, tex[i], nullptr, &rect[i]);
-            SDL_DestroyTexture(tex[i]);
-        } else if (nxtDesc[i].type == DescType::Text) {
-            SDL_Color col = {0,0,0,255};
-            SDL_Surface* surf = TTF_RenderUTF8_Blended(font, nxtDesc[i].label.c_str(), col);
-            tex[i] = SDL_CreateTextureFromSurface(renderer, surf);
-            SDL_FreeSurface(surf);
-            SDL_RenderCopy(renderer, tex[i], nullptr, &rect[i]);
-            SDL_DestroyTexture(tex[i]);
-        } else if (nxtDesc[i].type == DescType::Title) {
-            SDL_Color col = {0,0,0,255};
-            SDL_Surface* surf = TTF_RenderUTF8_Blended(titleFont, nxtDesc[i].label.c_str(), col);
-            tex[i] = SDL_CreateTextureFromSurface(renderer, surf);
-            SDL_FreeSurface(surf);
-            SDL_RenderCopy(renderer, tex[i], nullptr, &rect[i]);
-            SDL_DestroyTexture(tex[i]);
-        } else if (nxtDesc[i].type == DescType::Toggle) {
-            int ty = rect[i].y;
-            int w,h;
-            TTF_SizeUTF8(font, nxtDesc[i].label.c_str(), &w, &h);
-            SDL_Surface* surf = TTF_RenderUTF8_Blended(font, nxtDesc[i].label.c_str(), SDL_Color{0,0,0,255});
-            SDL_Texture* labelTex = SDL_CreateTextureFromSurface(renderer, surf);
-            SDL_FreeSurface(surf);
-            SDL_Rect lr = {5 * SCALE, ty + V_PADDING + (68 - h) / 2, w, h};
-            SDL_RenderCopy(renderer, labelTex, nullptr, &lr);
-            SDL_DestroyTexture(labelTex);
-            int tx = WIDTH * SCALE - 5 * SCALE - 132;
-            int ty0 = ty + V_PADDING;
-            bool& s = *nxtDesc[i].toggleState;
-            int toggW = 132, toggH = 68, innerPad = 5 * SCALE;
-            int circleD = toggH - 2 * innerPad;
-            SDL_SetRenderDrawBlendMode(renderer, SDL_BLENDMODE_BLEND);
-            Uint8 r0=0xe9,g0=0xe9,b0=0xeb;
-            Uint8 r1=0x69,g1=0xce,b1=0x67;
-            Uint8 rc = s?r1:r0, gc = s?g1:g0, bc = s?b1:b0;
-            roundedBoxRGBA(renderer, tx, ty0, tx + toggW - 1, ty0 + toggH - 1, toggH/2, rc, gc, bc, 255);
-            int cx = tx + innerPad + (s ? (toggW - 2*innerPad - circleD) : 0);
-            int cy = ty0 + innerPad;
-            filledCircleRGBA(renderer, cx + circleD/2, cy + circleD/2, circleD/2, 0xff,0xff,0xff,255);
-        } else if (nxtDesc[i].type == DescType::TextField) {
-            State& stf = nxtStates[i];
-            roundedBoxRGBA(renderer, rect[i].x, rect[i].y, rect[i].x + rect[i].w, rect[i].y + rect[i].h, TF_RADIUS, 255,255,255,255);
-            roundedRectangleRGBA(renderer, rect[i].x, rect[i].y, rect[i].x + rect[i].w, rect[i].y + rect[i].h, TF_RADIUS, 0x88,0x88,0x88,255);
-            std::string* txt = nxtDesc[i].textState;
-            bool empty = txt->empty();
-            SDL_Color tcol = empty?SDL_Color{0x88,0x88,0x88,255}:SDL_Color{0,0,0,255};
-            SDL_Surface* surf = TTF_RenderUTF8_Blended(font, (empty?nxtDesc[i].label:*txt).c_str(), tcol);
-            SDL_Texture* ttx = SDL_CreateTextureFromSurface(renderer, surf);
-            int th = surf->h, tw = surf->w;
-            SDL_FreeSurface(surf);
-            SDL_Rect tr = {rect[i].x + 5, rect[i].y + (TF_HEIGHT - th)/2, tw, th};
-            SDL_RenderCopy(renderer, ttx, nullptr, &tr);
-            SDL_DestroyTexture(ttx);
-            Uint32 now = SDL_GetTicks();
-            if (stf.tfFocused) {
-                if (now - stf.lastBlink > CURSOR_BLINK_INTERVAL) {
-                    stf.showCursor = !stf.showCursor;
-                    stf.lastBlink = now;
-                }
-                if (stf.showCursor) {
-                    int caretX = empty? rect[i].x + 5 : tr.x + tw;
-                    int cy0 = rect[i].y + 4;
-                    int cy1 = rect[i].y + TF_HEIGHT - 4;
-                    SDL_RenderDrawLine(renderer, caretX, cy0, caretX, cy1);
-                }
+            measureText(f, text.substr(start, next - start), &w, &h);
+            if (w > width) break;
+            end = next;
+            endW = w;
+        }
+        if (end == start) {
+            for (size_t c = start; c < hard;) {
+                c++;
+                while (c < hard && (text[c] & 0xC0) == 0x80) c++;
+                int w, h;
+                measureText(f, text.substr(start, c - start), &w, &h);
+                if (w > width && end > start) break;
+                end = c;
+                endW = w;
             }
-        } else if (nxtDesc[i].type == DescType::HStack) {
-            auto& tmp = hchildren[i];
-            int count = tmp.size();
-            if (!count) continue;
-            int slotW = WIDTH * SCALE / count;
-            for (int j = 0; j < count; j++) {
-                auto& d = tmp[j];
-                int x0 = j * slotW;
-                int y0 = rect[i].y;
-                if (d.type == DescType::Text || d.type == DescType::Button || d.type == DescType::Title) {
-                    SDL_Color col = d.type==DescType::Button? SDL_Color{0,102,255,255} : SDL_Color{0,0,0,255};
-                    TTF_Font* f = d.type==DescType::Title? titleFont : font;
-                    SDL_Surface* surf = TTF_RenderUTF8_Blended(f, d.label.c_str(), col);
-                    SDL_Texture* txr = SDL_CreateTextureFromSurface(renderer, surf);
-                    int w,h; SDL_QueryTexture(txr, nullptr, nullptr, &w,&h);
-                    SDL_FreeSurface(surf);
-                    SDL_Rect rr = {x0 + (slotW - w)/2, y0 + (rect[i].h - h)/2, w,h};
-                    SDL_RenderCopy(renderer, txr, nullptr, &rr);
-                    SDL_DestroyTexture(txr);
-                }
+        }
+        lb.starts.push_back(start);
+        lb.ends.push_back(end);
+        lb.widths.push_back(endW);
+        start = end;
+        while (start < hard && text[start] == ' ') start++;
+        if (start < hard) continue;
+        if (hard == text.size()) return;
+        start = hard + 1;
+    }
+}
+
+// Line breaks of a Paragraph at width, rewrapping only what its text changed
+// since the last layout.
+static const LineBreaks& lineBreaksFor(const Descriptor& d, TTF_Font* f, int width) {
+    auto key = std::make_tuple(d.id, f, width);
+    auto it = ctx->lineBreaks.find(key);
+    if (it == ctx->lineBreaks.end()) {
+        if (ctx->lineBreaks.size() >= LINE_BREAK_CACHE_LIMIT) ctx->lineBreaks.clear();
+        it = ctx->lineBreaks.emplace(key, LineBreaks()).first;
+    }
+    LineBreaks& lb = it->second;
+    const std::string& text = d.label;
+    if (!lb.starts.empty() && lb.text == text) return lb;
+    size_t from = 0;
+    if (!lb.starts.empty() && text.size() > lb.text.size() && text.compare(0, lb.text.size(), lb.text) == 0) {
+        from = lb.starts.back();
+        lb.starts.pop_back();
+        lb.ends.pop_back();
+        lb.widths.pop_back();
+        lb.text.append(text, lb.text.size(), std::string::npos);
+    } else {
+        lb = LineBreaks();
+        lb.text = text;
+    }
+    wrapLines(f, text, from, width, lb);
+    return lb;
+}
+
+// Copies out the lines of a Paragraph laid out in r and appends a node for
+// each, aligned within r. Returns the height of the lines.
+static int layoutParagraph(Descriptor& para, const SDL_Rect& r, int state, std::vector<Node>& nodes) {
+    const LineBreaks& lb = lineBreaksFor(para, ctx->font, r.w);
+    int lineH = TTF_FontHeight(ctx->font);
+    para.firstLine = 0;
+    para.lines.resize(lb.starts.size());
+    for (size_t i = 0; i < lb.starts.size(); i++) {
+        para.lines[i].assign(para.label, lb.starts[i], lb.ends[i] - lb.starts[i]);
+        int x = r.x;
+        if (para.align == TextAlign::Center) x += (r.w - lb.widths[i]) / 2;
+        else if (para.align == TextAlign::Right) x += r.w - lb.widths[i];
+        Node n = {&para, {x, r.y + int(i) * lineH, lb.widths[i], lineH}, state};
+        n.line = int(i);
+        nodes.push_back(n);
+    }
+    return int(lb.starts.size()) * lineH;
+}
+
+// Buffer position under the point (x, y) of a laid-out TextArea.
+static size_t textAreaOffsetAt(const Descriptor& area, const SDL_Rect& r, const State& st, int x, int y) {
+    const TextBuffer& buf = *area.textBuffer;
+    SDL_Rect inner = textAreaInner(r);
+    int line = int(std::floor((y - inner.y + st.scrollPos) / TTF_FontHeight(ctx->font)));
+    line = std::min(std::max(line, 0), int(buf.lineCount()) - 1);
+    std::string text;
+    buf.line(size_t(line), text);
+    return buf.lineStart(size_t(line)) + offsetAtX(text, x - inner.x);
+}
+
+// Lays out a descriptor list as a vertically centered stack. Every top-level
+// descriptor yields one node; HStack and List nodes are followed by nodes
+// for their children.
+static void layoutView(std::vector<Descriptor>& desc, std::vector<State>& states, std::vector<Node>& nodes) {
+    TRACE_SCOPE("layout");
+    nodes.clear();
+    int totalH = 0;
+    for (size_t i = 0; i < desc.size(); i++) {
+        Descriptor& d = desc[i];
+        if (d.type == DescType::Prefetch) continue;
+        SDL_Rect r = {0, 0, ctx->width, 0};
+        if (d.type == DescType::Toggle) {
+            r.h = px(TOGGLE_H) + 2 * px(V_PADDING);
+            if (!states[i].togAnimating) states[i].togPos = d.toggleValue ? 1.0f : 0.0f;
+        } else if (d.type == DescType::TextField) {
+            r = {px(TF_PADDING), 0, ctx->width - 2 * px(TF_PADDING), px(TF_HEIGHT)};
+        } else if (d.type == DescType::Image) {
+            int w = px(float(d.imgW)), h = px(float(d.imgH));
+            r = {(ctx->width - w) / 2, 0, w, h};
+        } else if (d.type == DescType::List) {
+            r.h = d.listHeight;
+        } else if (d.type == DescType::TextArea) {
+            r = {px(TF_PADDING), 0, ctx->width - 2 * px(TF_PADDING), d.listHeight};
+        } else if (d.type == DescType::Paragraph) {
+            r = {px(TF_PADDING), 0, std::max(ctx->width - 2 * px(TF_PADDING), 1), 0};
+        } else if (d.type != DescType::HStack) {
+            int w, h;
+            measureText(d.type == DescType::Title ? ctx->titleFont : ctx->font, d.label, &w, &h);
+            r = {(ctx->width - w) / 2, 0, w, h};
+        }
+        size_t at = nodes.size();
+        nodes.push_back({&d, r, int(i)});
+        if (d.type == DescType::HStack) nodes[at].rect.h = layoutRow(d.children, 0, 0, nodes, nullptr);
+        if (d.type == DescType::List) layoutList(d, states[i], nodes);
+        if (d.type == DescType::TextArea) layoutTextArea(d, r, states[i], int(i), nodes);
+        if (d.type == DescType::Paragraph) nodes[at].rect.h = layoutParagraph(d, r, int(i), nodes);
+        totalH += nodes[at].rect.h + (at ? px(SPACING) : 0);
+    }
+    int y = (ctx->height - totalH) / 2;
+    int parentY = 0;
+    for (Node& n : nodes) {
+        if (n.state < 0 || n.line >= 0) {
+            n.rect.y += parentY;
+            n.clip.y += parentY;
+            continue;
+        }
+        n.rect.y = parentY = y;
+        y += n.rect.h + px(SPACING);
+    }
+}
+
+// Keeps toggles no tween drives at their value and blinks carets.
+static void updateWidgets(const std::vector<Node>& nodes, std::vector<State>& states) {
+    double now = frameNow;
+    for (const Node& n : nodes) {
+        if (n.state < 0 || n.line >= 0) continue;
+        const Descriptor& d = *n.desc;
+        State& st = states[n.state];
+        if (d.type == DescType::Toggle && !st.togAnimating) st.togPos = d.toggleValue ? 1.0f : 0.0f;
+        if (st.tfFocused && now - st.lastBlink > CURSOR_BLINK_INTERVAL) {
+            st.showCursor = !st.showCursor;
+            st.lastBlink = now;
+        }
+    }
+}
+
+static bool& tweenFlag(State& st, TweenProp prop) {
+    switch (prop) {
+    case TweenProp::Alpha: return st.animating;
+    case TweenProp::TogglePos: return st.togAnimating;
+    default: return st.scrolling;
+    }
+}
+
+// Tweens property prop of states[state] from from to to, starting now.
+static void animate(std::vector<State>& states, int state, TweenProp prop, float from, float to, const Spring& spring) {
+    tweenFlag(states[state], prop) = true;
+    startTween(ctx->tweens, state, prop, from, to, frameNow, spring);
+}
+
+static void stopAnimation(std::vector<State>& states, int state, TweenProp prop) {
+    tweenFlag(states[state], prop) = false;
+    stopTween(ctx->tweens, state, prop);
+}
+
+// Writes the values advanceTweens() computed to the widget states and
+// retires the tweens that arrived. A toggle whose tween arrives commits its
+// value, to the user's bool and to its descriptor's copy; returns true if
+// one did, i.e. the view function may now build something else.
+static bool applyTweens(std::vector<Descriptor>& desc, std::vector<State>& states) {
+    Animations& a = ctx->tweens;
+    bool touched = false;
+    for (size_t i = a.state.size(); i-- > 0;) {
+        int state = a.state[i];
+        State& st = states[state];
+        float v = a.value[i];
+        if (a.prop[i] == TweenProp::Alpha) st.alpha = v;
+        else if (a.prop[i] == TweenProp::TogglePos) st.togPos = v;
+        else st.scrollPos = v;
+        if (!a.done[i]) continue;
+        tweenFlag(st, a.prop[i]) = false;
+        if (a.prop[i] == TweenProp::TogglePos) {
+            Descriptor* d = size_t(state) < desc.size() ? &desc[state] : nullptr;
+            if (d && d->type == DescType::Toggle && st.togPending) {
+                *d->toggleState = d->toggleValue = st.togTarget;
+                touched = true;
             }
-        } else if (nxtDesc[i].type == DescType::Image) {
-            SDL_Surface* surf = IMG_Load(("./Resources/" + nxtDesc[i].label).c_str());
-            SDL_Texture* imgTex = SDL_CreateTextureFromSurface(renderer, surf);
-            SDL_FreeSurface(surf);
-            SDL_RenderCopy(renderer, imgTex, nullptr, &rect[i]);
-            SDL_DestroyTexture(imgTex);
+            st.togPending = false;
         }
+        retireTween(a, i);
     }
-    SDL_SetRenderTarget(renderer, nullptr);
-    std::swap(currentTarget, nextTarget);
-    curViewFunc = nxtViewFunc;
-    curStates = nxtStates;
-    animatingOverlay = true;
-    overlayStart = SDL_GetTicks();
+    return touched;
 }
 
-void View(const std::function<void()>& viewFunc) {
+// Runs every tween to its end, before the states it drives go away.
+static void finishTweens() {
+    advanceTweens(ctx->tweens, INFINITY);
+    applyTweens(ctx->curDesc, ctx->curStates);
+}
+
+static bool isAnimating() {
+    return ctx->animatingOverlay || ctx->transitionPending || tweensRunning(ctx->tweens);
+}
+
+// Milliseconds until the next scheduled visual change while idle, or -1 if
+// nothing is scheduled. Only the text field caret blinks on its own, and
+// Image files are checked for changes while the view shows them.
+static int idleTimeout(const std::vector<Node>& nodes, const std::vector<State>& states) {
+    double now = clockMs();
+    int timeout = -1;
+    for (const State& st : states) {
+        if (!st.tfFocused) continue;
+        double due = st.lastBlink + CURSOR_BLINK_INTERVAL + 1;
+        int wait = due > now ? int(std::ceil(due - now)) : 0;
+        if (timeout < 0 || wait < timeout) timeout = wait;
+    }
+    if (!ctx->imageFiles.empty() && showsImages(nodes)) {
+        int wait = std::max(int(std::ceil(ctx->imagesCheckedAt + IMAGE_WATCH_INTERVAL - now)), 0);
+        if (timeout < 0 || wait < timeout) timeout = wait;
+    }
+    return timeout;
+}
+
+// Part of a TextArea's selection on line n, as [from, to) relative to the
+// line start. The newline counts as one past the end of the line's text.
+static bool lineSelection(const Node& n, size_t& from, size_t& to) {
+    const Descriptor& d = *n.desc;
+    size_t start = d.lineStarts[n.line - d.firstLine];
+    size_t end = start + d.lines[n.line - d.firstLine].size();
+    if (d.selStart == d.selEnd || d.selEnd <= start || d.selStart > end) return false;
+    from = std::max(d.selStart, start) - start;
+    to = std::min(d.selEnd, end + 1) - start;
+    return true;
+}
+
+// Caret position relative to the start of TextArea line n, or -1 if the
+// caret is hidden or on another line.
+static int lineCaret(const Node& n, const State& st) {
+    const Descriptor& d = *n.desc;
+    size_t start = d.lineStarts[n.line - d.firstLine];
+    size_t end = start + d.lines[n.line - d.firstLine].size();
+    if (!st.tfFocused || !st.showCursor || d.caret < start || d.caret > end) return -1;
+    return int(d.caret - start);
+}
+
+// Hash of everything paintNode reads for one node, so a node whose rect and
+// signature are unchanged does not need repainting.
+static size_t nodeSignature(const Node& n, const std::vector<State>& states) {
+    const Descriptor& d = *n.desc;
+    std::hash<std::string> str;
+    size_t h = size_t(d.type);
+    if (d.type == DescType::TextArea) {
+        if (n.line < 0) return h;
+        size_t from, to;
+        hashMix(h, str(d.lines[n.line - d.firstLine]));
+        if (lineSelection(n, from, to)) { hashMix(h, from); hashMix(h, to); }
+        hashMix(h, size_t(lineCaret(n, states[n.state]) + 1));
+        return h;
+    }
+    if (d.type == DescType::Paragraph) {
+        if (n.line >= 0) hashMix(h, str(d.lines[n.line]));
+        return h;
+    }
+    hashMix(h, str(d.label));
+    if (d.type == DescType::Toggle) hashMix(h, d.toggleValue);
+    if (d.type == DescType::TextField) hashMix(h, str(d.text));
+    if (d.type == DescType::Image) hashMix(h, imageVersion(d.label) << 1 | imageReady(d.label, n.rect.w, n.rect.h));
+    if (n.state < 0) return h;
+    const State& st = states[n.state];
+    hashMix(h, size_t(st.alpha * 255));
+    hashMix(h, size_t(st.togPos * 1024) << 1 | st.togAnimating);
+    hashMix(h, st.tfFocused && st.showCursor);
+    return h;
+}
+
+// Area of the render target a node paints over.
+static SDL_Rect paintBounds(const Node& n) {
+    if (n.clipped) {
+        Node inner = n;
+        inner.clipped = false;
+        SDL_Rect b = paintBounds(inner), r;
+        return SDL_IntersectRect(&b, &n.clip, &r) ? r : SDL_Rect{0, 0, 0, 0};
+    }
+    if (n.desc->type == DescType::HStack || n.desc->type == DescType::List) return {0, 0, 0, 0};
+    if (n.desc->type == DescType::Paragraph && n.line < 0) return {0, 0, 0, 0};
+    if (n.desc->type == DescType::TextArea && n.line < 0) return {n.rect.x, n.rect.y, n.rect.w + 1, n.rect.h + 1};
+    if (n.desc->type == DescType::TextField) {
+        const std::string& shown = n.desc->text.empty() ? n.desc->label : n.desc->text;
+        int w, h;
+        measureText(ctx->font, shown, &w, &h);
+        return {n.rect.x, n.rect.y, std::max(n.rect.w, px(TF_TEXT_INSET) + w) + 1, n.rect.h + 1};
+    }
+    return n.rect;
+}
+
+static void recordPaint(const std::vector<Node>& nodes, const std::vector<State>& states, std::vector<PaintRecord>& out) {
+    out.clear();
+    for (const Node& n : nodes) out.push_back({paintBounds(n), nodeSignature(n, states)});
+}
+
+static bool sameRect(const SDL_Rect& a, const SDL_Rect& b) {
+    return a.x == b.x && a.y == b.y && a.w == b.w && a.h == b.h;
+}
+
+// Adds r to the damage list, merging it into any rect it overlaps. Past
+// MAX_DAMAGE_RECTS everything collapses into one bounding rect.
+static void addDamage(std::vector<SDL_Rect>& damage, SDL_Rect r) {
+    if (r.w <= 0 || r.h <= 0) return;
+    for (size_t i = 0; i < damage.size();) {
+        if (SDL_HasIntersection(&damage[i], &r)) {
+            SDL_UnionRect(&damage[i], &r, &r);
+            damage.erase(damage.begin() + i);
+            i = 0;
+        } else i++;
+    }
+    damage.push_back(r);
+    if (damage.size() > MAX_DAMAGE_RECTS) {
+        for (size_t i = 1; i < damage.size(); i++) SDL_UnionRect(&damage[0], &damage[i], &damage[0]);
+        damage.resize(1);
+    }
+}
+
+// Compares this frame's paint records with what the target holds. Nodes are
+// matched by position; any difference damages both the old and new bounds.
+static void collectDamage(const std::vector<PaintRecord>& prev, const std::vector<PaintRecord>& cur, std::vector<SDL_Rect>& damage) {
+    damage.clear();
+    size_t n = std::max(prev.size(), cur.size());
+    for (size_t i = 0; i < n; i++) {
+        if (i < prev.size() && i < cur.size() && prev[i].signature == cur[i].signature && sameRect(prev[i].bounds, cur[i].bounds)) continue;
+        if (i < prev.size()) addDamage(damage, prev[i].bounds);
+        if (i < cur.size()) addDamage(damage, cur[i].bounds);
+    }
+}
+
+// Draws one laid-out node into the current render target.
+static void paintNode(const Node& n, const std::vector<State>& states) {
+    const Descriptor& d = *n.desc;
+    const SDL_Rect& r = n.rect;
+    if (d.type == DescType::Button) {
+        Uint8 alpha = n.state < 0 ? 255 : Uint8(states[n.state].alpha * 255);
+        drawText(ctx->font, d.label, SDL_Color{0,102,255,255}, r.x, r.y, alpha);
+    } else if (d.type == DescType::Text) {
+        drawText(ctx->font, d.label, SDL_Color{0,0,0,255}, r.x, r.y);
+    } else if (d.type == DescType::Title) {
+        drawText(ctx->titleFont, d.label, SDL_Color{0,0,0,255}, r.x, r.y);
+    } else if (d.type == DescType::Toggle) {
+        const State& st = states[n.state];
+        int w, h;
+        measureText(ctx->font, d.label, &w, &h);
+        drawText(ctx->font, d.label, SDL_Color{0,0,0,255}, px(TOGGLE_INSET), r.y + px(V_PADDING) + (px(TOGGLE_H) - h) / 2);
+        SDL_Rect sw = toggleSwitchRect(r);
+        float vPos = st.togPos;
+        int innerPad = px(TOGGLE_INSET);
+        int circleD = sw.h - 2 * innerPad;
+        Uint8 r0=0xe9,g0=0xe9,b0=0xeb;
+        Uint8 r1=0x69,g1=0xce,b1=0x67;
+        Uint8 rc=Uint8(r0+(r1-r0)*vPos), gc=Uint8(g0+(g1-g0)*vPos), bc=Uint8(b0+(b1-b0)*vPos);
+        drawShape(Shape::Fill, sw, sw.h / 2, SDL_Color{rc, gc, bc, 255});
+        int cx = sw.x + innerPad + int((sw.w - 2 * innerPad - circleD) * vPos), cy = sw.y + innerPad;
+        drawShape(Shape::Fill, SDL_Rect{cx, cy, circleD, circleD}, circleD / 2, SDL_Color{0xff,0xff,0xff,255});
+    } else if (d.type == DescType::TextField) {
+        const State& st = states[n.state];
+        SDL_Rect box = {r.x, r.y, r.w + 1, r.h + 1};
+        drawShape(Shape::Fill, box, px(TF_RADIUS), SDL_Color{255,255,255,255});
+        drawShape(Shape::Ring, box, px(TF_RADIUS), SDL_Color{0x88,0x88,0x88,255});
+        bool empty = d.text.empty();
+        SDL_Color tcol = empty ? SDL_Color{0x88,0x88,0x88,255} : SDL_Color{0,0,0,255};
+        int th = TTF_FontHeight(ctx->font);
+        int inset = px(TF_TEXT_INSET);
+        int tw = drawText(ctx->font, empty ? d.label : d.text, tcol, r.x + inset, r.y + (r.h - th) / 2);
+        if (st.tfFocused && st.showCursor) {
+            int caretX = empty ? r.x + inset : r.x + inset + tw;
+            SDL_SetRenderDrawColor(ctx->renderer, 0x88,0x88,0x88,255);
+            SDL_RenderDrawLine(ctx->renderer, caretX, r.y + px(TF_CARET_INSET), caretX, r.y + r.h - px(TF_CARET_INSET));
+        }
+    } else if (d.type == DescType::TextArea && n.line < 0) {
+        SDL_Rect box = {r.x, r.y, r.w + 1, r.h + 1};
+        drawShape(Shape::Fill, box, px(TF_RADIUS), SDL_Color{255,255,255,255});
+        drawShape(Shape::Ring, box, px(TF_RADIUS), SDL_Color{0x88,0x88,0x88,255});
+    } else if (d.type == DescType::TextArea) {
+        const std::string& text = d.lines[n.line - d.firstLine];
+        size_t from, to;
+        if (lineSelection(n, from, to)) {
+            int x0 = prefixWidth(text, from);
+            int x1 = to > text.size() ? prefixWidth(text, text.size()) + px(TA_INSET) : prefixWidth(text, to);
+            SDL_Rect sel = {r.x + x0, r.y, x1 - x0, r.h};
+            SDL_SetRenderDrawColor(ctx->renderer, 0xb3,0xd7,0xff,255);
+            SDL_RenderFillRect(ctx->renderer, &sel);
+        }
+        drawText(ctx->font, text, SDL_Color{0,0,0,255}, r.x, r.y);
+        int caret = lineCaret(n, states[n.state]);
+        if (caret >= 0) {
+            int caretX = r.x + prefixWidth(text, size_t(caret));
+            SDL_SetRenderDrawColor(ctx->renderer, 0x88,0x88,0x88,255);
+            SDL_RenderDrawLine(ctx->renderer, caretX, r.y, caretX, r.y + r.h - 1);
+        }
+    } else if (d.type == DescType::Paragraph && n.line >= 0) {
+        drawText(ctx->font, d.lines[n.line], SDL_Color{0,0,0,255}, r.x, r.y);
+    } else if (d.type == DescType::Image) {
+        const ImageEntry* img = cachedImage(d.label, r.w, r.h);
+        if (img && img->tex) {
+            SDL_Rect src = {0, 0, img->key.w, img->key.h};
+            SDL_RenderCopy(ctx->renderer, img->tex, &src, &r);
+        } else if (img && img->loading) {
+            SDL_SetRenderDrawColor(ctx->renderer, 0xee,0xee,0xee,255);
+            SDL_RenderFillRect(ctx->renderer, &r);
+        }
+    }
+}
+
+// Paints a node while area is the clip rect in effect, narrowing the clip
+// to the node's own clip rect if it has one.
+static void paintClipped(const Node& n, const std::vector<State>& states, const SDL_Rect& area) {
+    if (!n.clipped) {
+        paintNode(n, states);
+        return;
+    }
+    SDL_Rect c;
+    if (!SDL_IntersectRect(&area, &n.clip, &c)) return;
+    flushText();
+    SDL_RenderSetClipRect(ctx->renderer, &c);
+    paintNode(n, states);
+    flushText();
+    SDL_RenderSetClipRect(ctx->renderer, &area);
+}
+
+static void renderView(SDL_Texture* target, const std::vector<Node>& nodes, const std::vector<State>& states) {
+    TRACE_SCOPE("paint");
+    SDL_SetRenderTarget(ctx->renderer, target);
+    SDL_SetRenderDrawColor(ctx->renderer, 255,255,255,255);
+    SDL_RenderClear(ctx->renderer);
+    SDL_Rect area = {0, 0, ctx->width, ctx->height};
+    SDL_RenderSetClipRect(ctx->renderer, &area);
+    for (const Node& n : nodes) paintClipped(n, states, area);
+    flushText();
+    SDL_RenderSetClipRect(ctx->renderer, nullptr);
+    SDL_SetRenderTarget(ctx->renderer, nullptr);
+}
+
+// Clears and repaints only the damaged regions of target, clipping each
+// node to the region being repaired.
+static void repaintDamage(SDL_Texture* target, const std::vector<Node>& nodes, const std::vector<State>& states, const std::vector<SDL_Rect>& damage) {
+    TRACE_SCOPE("paint");
+    SDL_SetRenderTarget(ctx->renderer, target);
+    for (const SDL_Rect& r : damage) {
+        SDL_RenderSetClipRect(ctx->renderer, &r);
+        SDL_SetRenderDrawBlendMode(ctx->renderer, SDL_BLENDMODE_NONE);
+        SDL_SetRenderDrawColor(ctx->renderer, 255,255,255,255);
+        SDL_RenderFillRect(ctx->renderer, &r);
+        for (const Node& n : nodes) {
+            SDL_Rect b = paintBounds(n);
+            if (SDL_HasIntersection(&b, &r)) paintClipped(n, states, r);
+        }
+        flushText();
+    }
+    SDL_RenderSetClipRect(ctx->renderer, nullptr);
+    SDL_SetRenderTarget(ctx->renderer, nullptr);
+}
+
+// Applies an editing or navigation key to a focused TextArea. Returns
+// whether the key was used.
+static bool editTextArea(TextBuffer& buf, const SDL_Keysym& key) {
+    bool shift = key.mod & KMOD_SHIFT;
+    bool command = key.mod & (KMOD_CTRL | KMOD_GUI);
+    size_t caret = buf.caret();
+    size_t line = buf.lineOf(caret);
+    switch (key.sym) {
+    case SDLK_BACKSPACE: buf.erase(); break;
+    case SDLK_DELETE: buf.erase(true); break;
+    case SDLK_RETURN: buf.insert("\n"); break;
+    case SDLK_LEFT: buf.setCaret(buf.hasSelection() && !shift ? buf.selectionStart() : buf.prevChar(caret), shift); break;
+    case SDLK_RIGHT: buf.setCaret(buf.hasSelection() && !shift ? buf.selectionEnd() : buf.nextChar(caret), shift); break;
+    case SDLK_HOME: buf.setCaret(buf.lineStart(line), shift); break;
+    case SDLK_END: buf.setCaret(buf.lineEnd(line), shift); break;
+    case SDLK_UP:
+    case SDLK_DOWN: {
+        bool up = key.sym == SDLK_UP;
+        if (up ? line == 0 : line + 1 == buf.lineCount()) {
+            buf.setCaret(up ? 0 : buf.size(), shift);
+            break;
+        }
+        size_t target = up ? line - 1 : line + 1;
+        std::string text;
+        buf.line(line, text);
+        int x = prefixWidth(text, caret - buf.lineStart(line));
+        buf.line(target, text);
+        buf.setCaret(buf.lineStart(target) + offsetAtX(text, x), shift);
+        break;
+    }
+    case SDLK_a:
+        if (!command) return false;
+        buf.setCaret(0);
+        buf.setCaret(buf.size(), true);
+        break;
+    case SDLK_c:
+    case SDLK_x:
+        if (!command) return false;
+        if (!buf.hasSelection()) break;
+        SDL_SetClipboardText(buf.selectedText().c_str());
+        if (key.sym == SDLK_x) buf.erase();
+        break;
+    case SDLK_v:
+        if (!command) return false;
+        if (char* clip = SDL_GetClipboardText()) {
+            std::string text = clip;
+            SDL_free(clip);
+            text.erase(std::remove(text.begin(), text.end(), '\r'), text.end());
+            buf.insert(text);
+        }
+        break;
+    default: return false;
+    }
+    return true;
+}
+
+// Area of a node that reacts to the pointer, or an empty rect.
+static SDL_Rect hitRect(const Node& n) {
+    if (n.state < 0 || n.line >= 0) return {0, 0, 0, 0};
+    switch (n.desc->type) {
+    case DescType::Button:
+    case DescType::TextField:
+    case DescType::TextArea:
+    case DescType::List:
+        return n.rect;
+    case DescType::Toggle:
+        return toggleSwitchRect(n.rect);
+    default:
+        return {0, 0, 0, 0};
+    }
+}
+
+static void buildHitIndex(const std::vector<Node>& nodes, size_t stateCount) {
+    for (std::vector<int>& cell : ctx->hitCells) cell.clear();
+    ctx->stateNodes.assign(stateCount, -1);
+    for (size_t i = 0; i < nodes.size(); i++) {
+        if (nodes[i].state >= 0 && nodes[i].line < 0) ctx->stateNodes[nodes[i].state] = int(i);
+        SDL_Rect r = hitRect(nodes[i]);
+        if (r.w <= 0 || r.h <= 0) continue;
+        int col0 = std::max(r.x / HIT_CELL, 0), col1 = std::min((r.x + r.w) / HIT_CELL, ctx->hitCols - 1);
+        int row0 = std::max(r.y / HIT_CELL, 0), row1 = std::min((r.y + r.h) / HIT_CELL, ctx->hitRows - 1);
+        for (int row = row0; row <= row1; row++)
+            for (int col = col0; col <= col1; col++) ctx->hitCells[row * ctx->hitCols + col].push_back(int(i));
+    }
+}
+
+// Topmost interactive node whose hit rect contains (x, y), or -1.
+static int hitTest(const std::vector<Node>& nodes, int x, int y) {
+    if (x < 0 || y < 0 || x >= ctx->hitCols * HIT_CELL || y >= ctx->hitRows * HIT_CELL) return -1;
+    const std::vector<int>& cell = ctx->hitCells[(y / HIT_CELL) * ctx->hitCols + x / HIT_CELL];
+    for (auto it = cell.rbegin(); it != cell.rend(); ++it)
+        if (inRect(x, y, hitRect(nodes[*it]))) return *it;
+    return -1;
+}
+
+static const Node* nodeForState(const std::vector<Node>& nodes, int state) {
+    if (state < 0 || state >= int(ctx->stateNodes.size()) || ctx->stateNodes[state] < 0) return nullptr;
+    return &nodes[ctx->stateNodes[state]];
+}
+
+static void setFocus(int state, std::vector<State>& states) {
+    if (state == ctx->focusState) return;
+    if (ctx->focusState >= 0 && ctx->focusState < int(states.size())) states[ctx->focusState].tfFocused = false;
+    ctx->focusState = state;
+    if (state < 0) return;
+    states[state].tfFocused = true;
+    states[state].showCursor = true;
+    states[state].lastBlink = frameNow;
+}
+
+// Forgets focus and the pressed widget, once the states they index are gone.
+static void resetInput() {
+    ctx->focusState = -1;
+    ctx->pressedState = -1;
+}
+
+// Follows focus, the pressed widget and running tweens to where their
+// states moved.
+static void remapInput(const std::vector<int>& moved) {
+    auto follow = [&](int state) { return state >= 0 && state < int(moved.size()) ? moved[state] : -1; };
+    ctx->focusState = follow(ctx->focusState);
+    ctx->pressedState = follow(ctx->pressedState);
+    remapTweens(ctx->tweens, moved);
+}
+
+// Queues an SDL input event, mapping its timestamp onto clockMs().
+static void queueInput(const SDL_Event& e) {
+    Uint32 ticks = SDL_GetTicks();
+    InputEvent ev;
+    ev.at = clockMs() - double(ticks >= e.common.timestamp ? ticks - e.common.timestamp : 0);
+    switch (e.type) {
+    case SDL_MOUSEBUTTONDOWN:
+    case SDL_MOUSEBUTTONUP:
+        ev.kind = e.type == SDL_MOUSEBUTTONDOWN ? InputKind::Down : InputKind::Up;
+        ev.x = int(e.button.x * ctx->density);
+        ev.y = int(e.button.y * ctx->density);
+        break;
+    case SDL_MOUSEMOTION:
+        ev.x = ctx->pointerX = int(e.motion.x * ctx->density);
+        ev.y = ctx->pointerY = int(e.motion.y * ctx->density);
+        break;
+    case SDL_MOUSEWHEEL:
+        ev.kind = InputKind::Wheel;
+        ev.x = ctx->pointerX;
+        ev.y = ctx->pointerY;
+        ev.wheel = e.wheel.direction == SDL_MOUSEWHEEL_FLIPPED ? -e.wheel.y : e.wheel.y;
+        break;
+    case SDL_TEXTINPUT:
+        ev.kind = InputKind::Text;
+        ev.text = e.text.text;
+        break;
+    case SDL_KEYDOWN:
+        ev.kind = InputKind::Key;
+        ev.key = e.key.keysym;
+        break;
+    default:
+        return;
+    }
+    ctx->inputQueue.push_back(std::move(ev));
+}
+
+// Starts a spring scroll on list node n, moving its target by delta pixels.
+static void scrollList(const Node& n, std::vector<State>& states, float delta) {
+    State& st = states[n.state];
+    float from = scrollOffset(*n.desc, st);
+    st.scrollTo = std::min(std::max(st.scrollTo + delta, 0.0f), float(maxScroll(*n.desc)));
+    if (st.scrollTo != from) animate(states, n.state, TweenProp::Scroll, from, st.scrollTo, n.desc->spring);
+    else stopAnimation(states, n.state, TweenProp::Scroll);
+}
+
+// Routes one queued event against the last layout: a press to the node
+// under the pointer, the rest of the gesture to the node that took the
+// press, wheel ticks to the list under the pointer and keys to the focus
+// target.
+static void dispatchInput(const InputEvent& ev, const std::vector<Node>& nodes, std::vector<State>& states) {
+    if (ev.kind == InputKind::Down) {
+        int hit = hitTest(nodes, ev.x, ev.y);
+        const Node* n = hit >= 0 ? &nodes[hit] : nullptr;
+        bool editable = n && (n->desc->type == DescType::TextField || n->desc->type == DescType::TextArea);
+        setFocus(editable ? n->state : -1, states);
+        ctx->pressedState = n ? n->state : -1;
+        if (!n) return;
+        const Descriptor& d = *n->desc;
+        State& st = states[n->state];
+        if (d.type == DescType::Button) {
+            d.cb();
+            st.pressed = true;
+            stopAnimation(states, n->state, TweenProp::Alpha);
+            st.alpha = PRESSED_ALPHA;
+        } else if (d.type == DescType::Toggle) {
+            st.togPressed = true;
+            st.togPending = true;
+            st.togTarget = !*d.toggleState;
+        } else if (d.type == DescType::TextArea) {
+            d.textBuffer->setCaret(textAreaOffsetAt(d, n->rect, st, ev.x, ev.y), SDL_GetModState() & KMOD_SHIFT);
+        }
+        return;
+    }
+    const Node* pressed = nodeForState(nodes, ctx->pressedState);
+    if (ev.kind == InputKind::Move) {
+        if (pressed && pressed->desc->type == DescType::TextArea)
+            pressed->desc->textBuffer->setCaret(textAreaOffsetAt(*pressed->desc, pressed->rect, states[ctx->pressedState], ev.x, ev.y), true);
+        return;
+    }
+    if (ev.kind == InputKind::Up) {
+        ctx->pressedState = -1;
+        if (!pressed) return;
+        State& st = states[pressed->state];
+        bool inside = hitTest(nodes, ev.x, ev.y) == int(pressed - nodes.data());
+        if (st.pressed) {
+            st.pressed = false;
+            if (inside) animate(states, pressed->state, TweenProp::Alpha, PRESSED_ALPHA, NORMAL_ALPHA, pressed->desc->spring);
+            else st.alpha = NORMAL_ALPHA;
+        }
+        if (st.togPressed) {
+            st.togPressed = false;
+            if (inside) animate(states, pressed->state, TweenProp::TogglePos, st.togTarget ? 0.0f : 1.0f, st.togTarget ? 1.0f : 0.0f, pressed->desc->spring);
+            else st.togPending = false;
+        }
+        return;
+    }
+    if (ev.kind == InputKind::Wheel) {
+        int hit = hitTest(nodes, ev.x, ev.y);
+        if (hit >= 0 && nodes[hit].desc->type == DescType::List)
+            scrollList(nodes[hit], states, float(-ev.wheel * px(SCROLL_STEP)));
+        return;
+    }
+    const Node* focus = nodeForState(nodes, ctx->focusState);
+    if (!focus) return;
+    const Descriptor& d = *focus->desc;
+    State& st = states[ctx->focusState];
+    st.showCursor = true;
+    st.lastBlink = frameNow;
+    if (d.type == DescType::TextField) {
+        if (ev.kind == InputKind::Text) *d.textState += ev.text;
+        else if (ev.key.sym == SDLK_BACKSPACE) eraseLastUtf8Char(*d.textState);
+    } else if (ev.kind == InputKind::Text) {
+        d.textBuffer->insert(ev.text);
+    } else {
+        editTextArea(*d.textBuffer, ev.key);
+    }
+}
+
+void SetFrameCallback(const std::function<void(const FrameStats&)>& cb) {
+    frameCallback = cb;
+}
+
+void SetFrameRate(int fps) {
+    targetFps = std::max(fps, 1);
+}
+
+void SetVSync(bool enabled) {
+    vsync = enabled;
+#if SDL_VERSION_ATLEAST(2,0,18)
+    for (Context* c : contexts) SDL_RenderSetVSync(c->renderer, enabled ? 1 : 0);
+#endif
+}
+
+FrameHistogram GetFrameHistogram() {
+    FrameHistogram h = histogram;
+    h.targetMs = framePeriod();
+    return h;
+}
+
+void ResetFrameHistogram() {
+    std::fill(histogram.counts.begin(), histogram.counts.end(), 0);
+    histogram.frames = histogram.missed = 0;
+}
+
+double FrameHistogram::percentile(double p) const {
+    Uint64 rank = Uint64(p * frames), seen = 0;
+    for (size_t i = 0; i < counts.size(); i++) {
+        seen += counts[i];
+        if (seen > rank) return (i + 0.5) * bucketMs;
+    }
+    return counts.size() * bucketMs;
+}
+
+void SetImageCacheBudget(size_t bytes) {
+    imageBudget = bytes;
+    Context* caller = ctx;
+    for (Context* c : contexts) {
+        useContext(c);
+        while (!c->imageLru.empty() && c->imageBytes > imageBudget) evictImage();
+    }
+    useContext(caller);
+}
+
+void SetRenderMode(RenderMode mode) {
+    renderMode = mode;
+}
+
+void Invalidate() {
+    wakeWindow(0);
+}
+
+// Asks for a transition once the current frame has been painted. Ignored
+// while another one is pending or running.
+static void requestTransition(NavOp op, const std::function<void()>& viewFunc, const Spring& spring) {
+    if (!ctx || ctx->animatingOverlay || ctx->transitionPending) return;
+    ctx->navOp = op;
+    ctx->nxtViewFunc = viewFunc;
+    ctx->transitionSpring = spring;
+    ctx->transitionPending = true;
+}
+
+void PushView(const std::function<void()>& viewFunc, const Spring& spring) {
+    requestTransition(NavOp::Push, viewFunc, spring);
+}
+
+void PopView(const Spring& spring) {
+    if (ctx && !ctx->backStack.empty()) requestTransition(NavOp::Pop, ctx->backStack.back().viewFunc, spring);
+}
+
+void ReplaceView(const std::function<void()>& viewFunc, const Spring& spring) {
+    requestTransition(NavOp::Replace, viewFunc, spring);
+}
+
+void NewView(const std::function<void()>& viewFunc, const Spring& spring) {
+    PushView(viewFunc, spring);
+}
+
+void PrefetchView(void (*viewFunc)()) {
+    if (viewFunc) push(DescType::Prefetch, {}, CALL_SITE()).cb = viewFunc;
+}
+
+void SetViewCacheBudget(size_t bytes) {
+    viewCacheBudget = bytes;
+}
+
+// The plain function behind a view function, which is what prefetched views
+// are matched by, or null for lambdas and other callables.
+static void (*viewId(const std::function<void()>& viewFunc))() {
+    auto fn = viewFunc.target<void (*)()>();
+    return fn ? *fn : nullptr;
+}
+
+static SDL_Texture* createTarget() {
+    SDL_Texture* t = SDL_CreateTexture(ctx->renderer, SDL_PIXELFORMAT_RGBA8888, SDL_TEXTUREACCESS_TARGET, ctx->width, ctx->height);
+    SDL_SetTextureBlendMode(t, SDL_BLENDMODE_BLEND);
+    counters->texturesCreated++;
+    return t;
+}
+
+// Takes the spare target, creating one if a snapshot kept the last spare.
+static SDL_Texture* takeSpareTarget() {
+    SDL_Texture* t = ctx->nextTarget;
+    ctx->nextTarget = nullptr;
+    return t ? t : createTarget();
+}
+
+// Keeps a target no longer shown as the spare, or destroys it if there is one.
+static void releaseTarget(SDL_Texture* t) {
+    if (ctx->nextTarget) SDL_DestroyTexture(t);
+    else ctx->nextTarget = t;
+}
+
+// Ends the slide of a transition, releasing the outgoing view's target
+// unless a snapshot on the back stack keeps it.
+static void endSlide() {
+    if (ctx->slideFrom && ctx->slideOwned) releaseTarget(ctx->slideFrom);
+    ctx->slideFrom = nullptr;
+    ctx->slideOwned = false;
+}
+
+static void dropSnapshot(Snapshot& snap) {
+    if (snap.target) SDL_DestroyTexture(snap.target);
+    snap.target = nullptr;
+    snap.records.clear();
+}
+
+static size_t snapshotCount() {
+    size_t n = 0;
+    for (const Screen& s : ctx->backStack) n += s.snapshot.target != nullptr;
+    for (const Screen& s : ctx->prefetched) n += s.snapshot.target != nullptr;
+    return n;
+}
+
+static size_t snapshotBytes() {
+    return size_t(ctx->width) * size_t(ctx->height) * 4;
+}
+
+// Drops the least recently shown snapshots until the rest fit in the view
+// cache budget. The target sliding out right now is kept until it's done.
+static void trimSnapshots() {
+    while (snapshotCount() * snapshotBytes() > viewCacheBudget) {
+        Snapshot* oldest = nullptr;
+        for (auto* screens : {&ctx->backStack, &ctx->prefetched})
+            for (Screen& s : *screens)
+                if (s.snapshot.target && s.snapshot.target != ctx->slideFrom && (!oldest || s.snapshot.usedAt < oldest->usedAt))
+                    oldest = &s.snapshot;
+        if (!oldest) break;
+        dropSnapshot(*oldest);
+    }
+    auto dropped = [](const Screen& s) { return !s.snapshot.target; };
+    ctx->prefetched.erase(std::remove_if(ctx->prefetched.begin(), ctx->prefetched.end(), dropped), ctx->prefetched.end());
+}
+
+// Drops every snapshot, for when the window's size or scale changed.
+static void clearSnapshots() {
+    for (Screen& s : ctx->backStack) dropSnapshot(s.snapshot);
+    for (Screen& s : ctx->prefetched) dropSnapshot(s.snapshot);
+    ctx->prefetched.clear();
+}
+
+// Starts the slide transition to the view requested by PushView, PopView or
+// ReplaceView. The incoming view is shown from its snapshot when there is
+// one, from the back stack or a prefetch, and is painted into the spare
+// target otherwise; either way the next frame repaints what changed since.
+// Runs after the current frame has been painted so the outgoing view stays
+// intact while its descriptors are still in use.
+static void beginTransition() {
+    TRACE_SCOPE("NewView");
+    ctx->transitionPending = false;
+    finishTweens();
+    SDL_Texture* outgoing = ctx->currentTarget;
+    Snapshot incoming;
+    ctx->nxtStates.clear();
+    if (ctx->navOp == NavOp::Pop) {
+        Screen& back = ctx->backStack.back();
+        ctx->nxtStates.swap(back.states);
+        incoming = std::move(back.snapshot);
+        ctx->backStack.pop_back();
+    } else if (auto id = viewId(ctx->nxtViewFunc)) {
+        for (size_t i = 0; i < ctx->prefetched.size(); i++) {
+            if (viewId(ctx->prefetched[i].viewFunc) != id) continue;
+            incoming = std::move(ctx->prefetched[i].snapshot);
+            ctx->prefetched.erase(ctx->prefetched.begin() + i);
+            break;
+        }
+    }
+    buildView(ctx->nxtViewFunc, ctx->nxtDesc, ctx->nxtStates);
+    layoutView(ctx->nxtDesc, ctx->nxtStates, ctx->nxtNodes);
+    if (ctx->navOp == NavOp::Push)
+        ctx->backStack.push_back({ctx->curViewFunc, ctx->curStates, {outgoing, ctx->paintedRecords, frameNow}});
+    if (incoming.target) {
+        ctx->currentTarget = incoming.target;
+        ctx->paintedRecords.swap(incoming.records);
+    } else {
+        ctx->currentTarget = takeSpareTarget();
+        renderView(ctx->currentTarget, ctx->nxtNodes, ctx->nxtStates);
+        recordPaint(ctx->nxtNodes, ctx->nxtStates, ctx->paintedRecords);
+    }
+    std::swap(ctx->curDesc, ctx->nxtDesc);
+    ctx->curNodes.swap(ctx->nxtNodes);
+    ctx->curViewFunc = ctx->nxtViewFunc;
+    ctx->curStates = ctx->nxtStates;
+    buildHitIndex(ctx->curNodes, ctx->curStates.size());
+    resetInput();
+    clearTweens(ctx->tweens);
+    // The outgoing target stays alive until the slide has drawn it for the
+    // last time.
+    ctx->slideFrom = outgoing;
+    ctx->slideOwned = ctx->navOp != NavOp::Push;
+    ctx->slideBack = ctx->navOp == NavOp::Pop;
+    ctx->animatingOverlay = true;
+    ctx->overlayStart = frameNow;
+    trimSnapshots();
+}
+
+// Pipelined mode builds and lays out the next frame on a worker thread while
+// the UI thread paints and presents the current one. Between startPipeline()
+// and finishPipeline() the worker owns workDesc, workNodes and workStates;
+// the UI thread adopts them at the start of its next frame and dispatches
+// input against them as usual. That layout is the one the frame is about to
+// present, not the one on screen when the input happened; the two differ
+// only where the View function moved widgets in between.
+static bool pipelined = false;
+
+// Renders ahead the glyphs of every label the paint of nodes will draw.
+static void prepareGlyphs(const std::vector<Node>& nodes) {
+    TRACE_SCOPE("prepare glyphs");
+    for (const Node& n : nodes) {
+        const Descriptor& d = *n.desc;
+        if (d.type == DescType::TextArea && n.line >= 0) prepareText(ctx->font, d.lines[n.line - d.firstLine]);
+        else if (d.type == DescType::Paragraph && n.line >= 0) prepareText(ctx->font, d.lines[n.line]);
+        else if (d.type == DescType::TextField) prepareText(ctx->font, d.text.empty() ? d.label : d.text);
+        else if (isTextType(d.type) || d.type == DescType::Toggle) prepareText(d.type == DescType::Title ? ctx->titleFont : ctx->font, d.label);
+    }
+}
+
+static int pipelineWorker(void* owner) {
+    ctx = static_cast<Context*>(owner);
+    counters = &ctx->workStats;
+    SDL_LockMutex(ctx->pipelineMutex);
+    for (;;) {
+        while (!ctx->pipelineQuit && !ctx->pipelineStart) SDL_CondWait(ctx->pipelineWake, ctx->pipelineMutex);
+        if (ctx->pipelineQuit) break;
+        ctx->pipelineStart = false;
+        SDL_UnlockMutex(ctx->pipelineMutex);
+        Uint64 phase = SDL_GetPerformanceCounter();
+        ctx->workMoved = buildView(ctx->curViewFunc, ctx->workDesc, ctx->workStates, &ctx->workMoves);
+        ctx->workStats.build = lapMs(phase);
+        layoutView(ctx->workDesc, ctx->workStates, ctx->workNodes);
+        prepareGlyphs(ctx->workNodes);
+        ctx->workStats.layout = lapMs(phase);
+        SDL_LockMutex(ctx->pipelineMutex);
+        ctx->pipelineBusy = false;
+        SDL_CondSignal(ctx->pipelineWake);
+    }
+    SDL_UnlockMutex(ctx->pipelineMutex);
+    return 0;
+}
+
+static void stopPipeline() {
+    if (!ctx->pipelineThread) return;
+    SDL_LockMutex(ctx->pipelineMutex);
+    ctx->pipelineQuit = true;
+    SDL_CondSignal(ctx->pipelineWake);
+    SDL_UnlockMutex(ctx->pipelineMutex);
+    SDL_WaitThread(ctx->pipelineThread, nullptr);
+    SDL_DestroyCond(ctx->pipelineWake);
+    SDL_DestroyMutex(ctx->pipelineMutex);
+    ctx->pipelineThread = nullptr;
+    ctx->pipelineWake = nullptr;
+    ctx->pipelineMutex = nullptr;
+    ctx->pipelineQuit = ctx->pipelineReady = false;
+}
+
+// Hands the build and layout of the next frame to the worker, starting it
+// on first use. Falls back to building on the UI thread if it can't start.
+static void startPipeline() {
+    if (!ctx->pipelineThread) {
+        ctx->pipelineMutex = SDL_CreateMutex();
+        ctx->pipelineWake = SDL_CreateCond();
+        ctx->pipelineThread = SDL_CreateThread(pipelineWorker, "view pipeline", ctx);
+        if (!ctx->pipelineThread) {
+            SDL_DestroyCond(ctx->pipelineWake);
+            SDL_DestroyMutex(ctx->pipelineMutex);
+            ctx->pipelineWake = nullptr;
+            ctx->pipelineMutex = nullptr;
+            pipelined = false;
+            return;
+        }
+    }
+    ctx->workStates = ctx->curStates;
+    ctx->workStats = FrameStats();
+    ctx->pipelineReady = true;
+    SDL_LockMutex(ctx->pipelineMutex);
+    ctx->pipelineStart = ctx->pipelineBusy = true;
+    SDL_CondSignal(ctx->pipelineWake);
+    SDL_UnlockMutex(ctx->pipelineMutex);
+}
+
+static void waitPipeline() {
+    if (!ctx->pipelineThread) return;
+    TRACE_SCOPE("pipeline wait");
+    SDL_LockMutex(ctx->pipelineMutex);
+    while (ctx->pipelineBusy) SDL_CondWait(ctx->pipelineWake, ctx->pipelineMutex);
+    SDL_UnlockMutex(ctx->pipelineMutex);
+}
+
+// Waits for the worker to go idle. Returns whether it left a frame to adopt.
+static bool finishPipeline() {
+    if (!ctx->pipelineThread) return false;
+    waitPipeline();
+    bool ready = ctx->pipelineReady;
+    ctx->pipelineReady = false;
+    return ready;
+}
+
+// Makes the frame the worker built current, with its build and layout
+// times and work counters.
+static void adoptPipeline() {
+    std::swap(ctx->curDesc, ctx->workDesc);
+    ctx->curNodes.swap(ctx->workNodes);
+    ctx->curStates.swap(ctx->workStates);
+    if (ctx->workMoved) remapInput(ctx->workMoves);
+    buildHitIndex(ctx->curNodes, ctx->curStates.size());
+    ctx->frameStats.build = ctx->workStats.build;
+    ctx->frameStats.layout = ctx->workStats.layout;
+    ctx->frameStats.textRasterized += ctx->workStats.textRasterized;
+    ctx->frameStats.textMeasured += ctx->workStats.textMeasured;
+    ctx->frameStats.descriptorsBuilt += ctx->workStats.descriptorsBuilt;
+}
+
+// Renders ahead one view the current view declared with PrefetchView() and
+// drops prefetched views it no longer declares. Only renders while every
+// snapshot fits in the view cache budget, so prefetching never pushes out
+// the back stack. Returns whether it rendered a view.
+static bool prefetchView() {
+    auto declared = [](const Screen& s) {
+        for (const Descriptor& d : ctx->curDesc)
+            if (d.type == DescType::Prefetch && viewId(d.cb) == viewId(s.viewFunc)) return true;
+        return false;
+    };
+    for (Screen& s : ctx->prefetched)
+        if (!declared(s)) dropSnapshot(s.snapshot);
+    trimSnapshots();
+    for (const Descriptor& d : ctx->curDesc) {
+        if (d.type != DescType::Prefetch) continue;
+        auto id = viewId(d.cb);
+        bool done = std::any_of(ctx->prefetched.begin(), ctx->prefetched.end(), [&](const Screen& s) { return viewId(s.viewFunc) == id; });
+        if (done) continue;
+        if ((snapshotCount() + 1) * snapshotBytes() > viewCacheBudget) return false;
+        TRACE_SCOPE("prefetch");
+        // The view function must not run on both threads at once.
+        waitPipeline();
+        Screen s;
+        s.viewFunc = d.cb;
+        std::vector<Descriptor> desc;
+        std::vector<Node> nodes;
+        buildView(s.viewFunc, desc, s.states);
+        layoutView(desc, s.states, nodes);
+        s.snapshot.target = takeSpareTarget();
+        renderView(s.snapshot.target, nodes, s.states);
+        recordPaint(nodes, s.states, s.snapshot.records);
+        s.snapshot.usedAt = frameNow;
+        ctx->prefetched.push_back(std::move(s));
+        return true;
+    }
+    return false;
+}
+
+void SetPipelined(bool enabled) {
+    pipelined = enabled;
+}
+
+// Opens SDL for the first window of the process.
+static void startFramework() {
     SDL_Init(SDL_INIT_VIDEO);
     TTF_Init();
     IMG_Init(IMG_INIT_PNG);
-    springValues = loadSpring("./Resources/Spring.json");
-    window = SDL_CreateWindow("serviettUI", SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED, WIDTH, HEIGHT, SDL_WINDOW_ALLOW_HIGHDPI);
-    renderer = SDL_CreateRenderer(window, -1, SDL_RENDERER_ACCELERATED | SDL_RENDERER_TARGETTEXTURE);
-    font = TTF_OpenFont("./Resources/Inter.ttf", 18 * SCALE);
-    titleFont = TTF_OpenFont("./Resources/Inter.ttf", 36 * SCALE);
-    currentTarget = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_RGBA8888, SDL_TEXTUREACCESS_TARGET, WIDTH * SCALE, HEIGHT * SCALE);
-    nextTarget    = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_RGBA8888, SDL_TEXTUREACCESS_TARGET, WIDTH * SCALE, HEIGHT * SCALE);
-    SDL_SetTextureBlendMode(currentTarget, SDL_BLENDMODE_BLEND);
-    SDL_SetTextureBlendMode(nextTarget,    SDL_BLENDMODE_BLEND);
-    curViewFunc = viewFunc;
-    bool running = true;
-    SDL_Event e;
-    bool mouseDown = false, mouseUp = false;
-    int downX=0, downY=0, upX=0, upY=0;
-    curDesc.clear();
-    curViewFunc();
-    if (curStates.size() != curDesc.size()) curStates.assign(curDesc.size(), State());
-    SDL_StartTextInput();
-    while (running) {
-        Uint32 start = SDL_GetTicks();
-        mouseDown = mouseUp = false;
-        while (SDL_PollEvent(&e)) {
-            if (e.type == SDL_QUIT) running = false;
-            if (e.type == SDL_MOUSEBUTTONDOWN) {
-                mouseDown = true;
-                SDL_GetMouseState(&downX,&downY);
-                downX *= SCALE; downY *= SCALE;
-                int totalH = 0;
-                for (auto& d : curDesc) {
-                    if (d.type == DescType::Toggle) totalH += 68+2*V_PADDING+SPACING;
-                    else if (d.type == DescType::TextField) totalH += TF_HEIGHT+SPACING;
-                    else if (d.type == DescType::HStack) {
-                        std::vector<Descriptor> tmp;
-                        auto save=curDesc; curDesc.clear();
-                        d.cb();
-                        tmp=curDesc;
-                        curDesc=save;
-                        int hh=0;
-                        for (auto& c:tmp){
-                            int w,h;
-                            if (c.type==DescType::Text||c.type==DescType::Button||c.type==DescType::Title)
-                                TTF_SizeUTF8(c.type==DescType::Title?titleFont:font, c.label.c_str(), &w,&h),
-                                hh=std::max(hh,h);
-                        }
-                        totalH += hh+SPACING;
-                    } else if (d.type == DescType::Image) totalH += d.imgH + SPACING;
-                    else if (d.type == DescType::Title) {
-                        int w,h;
-                        TTF_SizeUTF8(titleFont, d.label.c_str(), &w,&h);
-                        totalH += h+SPACING;
-                    } else {
-                        int w,h;
-                        TTF_SizeUTF8(font,d.label.c_str(),&w,&h);
-                        totalH+=h+SPACING;
-                    }
-                }
-                int yy = (HEIGHT*SCALE - totalH)/2;
-                for (int i = 0; i < (int)curDesc.size(); i++) {
-                    if (curDesc[i].type == DescType::TextField) {
-                        SDL_Rect r = {TF_PADDING, yy, WIDTH*SCALE-2*TF_PADDING, TF_HEIGHT};
-                        yy += TF_HEIGHT+SPACING;
-                        if (downX>=r.x&&downX<=r.x+r.w&&downY>=r.y&&downY<=r.y+r.h) curStates[i].tfFocused=true;
-                        else curStates[i].tfFocused=false;
-                    } else if (curDesc[i].type == DescType::Toggle) yy += 68+2*V_PADDING+SPACING;
-                    else if (curDesc[i].type == DescType::HStack) {
-                        std::vector<Descriptor> tmp;
-                        auto save=curDesc; curDesc.clear();
-                        curDesc[i].cb();
-                        tmp=curDesc;
-                        curDesc=save;
-                        int hh=0;
-                        for (auto& c:tmp){
-                            int w,h;
-                            if (c.type==DescType::Text||c.type==DescType::Button||c.type==DescType::Title)
-                                TTF_SizeUTF8(c.type==DescType::Title?titleFont:font, c.label.c_str(), &w,&h),
-                                hh=std::max(hh,h);
-                        }
-                        yy+=hh+SPACING;
-                    } else if (curDesc[i].type == DescType::Image) {
-                        yy += curDesc[i].imgH + SPACING;
-                    } else if (curDesc[i].type == DescType::Title) {
-                        int w,h;
-                        TTF_SizeUTF8(titleFont, curDesc[i].label.c_str(), &w,&h);
-                        yy += h+SPACING;
-                    } else {
-                        int w,h;
-                        TTF_SizeUTF8(font,curDesc[i].label.c_str(),&w,&h);
-                        yy+=h+SPACING;
-                    }
-                }
-            }
-            if (e.type == SDL_MOUSEBUTTONUP) {
-                mouseUp = true;
-                SDL_GetMouseState(&upX,&upY);
-                upX *= SCALE; upY *= SCALE;
-            }
-            if (e.type == SDL_TEXTINPUT) {
-                for (int i = 0; i < (int)curDesc.size(); i++) {
-                    if (curDesc[i].type == DescType::TextField && curStates[i].tfFocused) {
-                        *curDesc[i].textState += e.text.text;
-                    }
-                }
-            }
-            if (e.type == SDL_KEYDOWN && e.key.keysym.sym == SDLK_BACKSPACE) {
-                for (int i = 0; i < (int)curDesc.size(); i++) {
-                    if (curDesc[i].type == DescType::TextField && curStates[i].tfFocused) {
-                        eraseLastUtf8Char(*curDesc[i].textState);
-                    }
-                }
-            }
+    fontMutex = SDL_CreateMutex();
+    invalidateEvent = SDL_RegisterEvents(1);
+    nextDeadline = clockMs();
+}
+
+// Releases what startFramework() opened, once the last window is closed.
+static void stopFramework() {
+    if (const char* tracePath = SDL_getenv("SERVIETTUI_TRACE_FILE")) DumpTrace(tracePath);
+    invalidateEvent = Uint32(-1);
+    fontMetrics.clear();
+    SDL_DestroyMutex(fontMutex);
+    fontMutex = nullptr;
+    closeFonts();
+    IMG_Quit();
+    TTF_Quit();
+    SDL_Quit();
+}
+
+// Reads the drawable size and pixel density of the current window, and on a
+// change resizes its render targets and picks fonts for the new scale.
+// Where the window system scales windows itself (macOS, Wayland, Windows
+// with DPI scaling) a point is one window coordinate; elsewhere window
+// coordinates are pixels and the display DPI sets the scale. Runs while the
+// pipeline worker is idle. Returns whether anything changed.
+static bool updateMetrics() {
+    int winW, winH, outW, outH;
+    SDL_GetWindowSize(ctx->window, &winW, &winH);
+    if (SDL_GetRendererOutputSize(ctx->renderer, &outW, &outH) != 0) {
+        outW = winW;
+        outH = winH;
+    }
+    float density = winW > 0 ? float(outW) / float(winW) : 1.0f;
+    float scale = density;
+#ifndef __APPLE__
+    float dpi;
+    if (density == 1.0f && SDL_GetDisplayDPI(SDL_GetWindowDisplayIndex(ctx->window), nullptr, &dpi, nullptr) == 0)
+        scale = std::max(1.0f, std::round(dpi / BASE_DPI * 4) / 4);
+#endif
+    if (outW == ctx->width && outH == ctx->height && scale == ctx->scale && density == ctx->density) return false;
+    // Snapshots no longer match the window; a running slide ends here.
+    ctx->animatingOverlay = false;
+    endSlide();
+    clearSnapshots();
+    ctx->lineBreaks.clear();
+    if (outW != ctx->width || outH != ctx->height) {
+        if (ctx->currentTarget) SDL_DestroyTexture(ctx->currentTarget);
+        if (ctx->nextTarget) SDL_DestroyTexture(ctx->nextTarget);
+        ctx->width = outW;
+        ctx->height = outH;
+        ctx->currentTarget = createTarget();
+        ctx->nextTarget = nullptr;
+        ctx->hitCols = (outW + HIT_CELL - 1) / HIT_CELL;
+        ctx->hitRows = (outH + HIT_CELL - 1) / HIT_CELL;
+        ctx->hitCells.assign(size_t(ctx->hitCols) * ctx->hitRows, {});
+    }
+    if (scale != ctx->scale) {
+        // Scroll offsets are kept in pixels; carry them over to the new scale.
+        float ratio = ctx->scale > 0 ? scale / ctx->scale : 1.0f;
+        for (State& st : ctx->curStates) {
+            st.scrollTo *= ratio;
+            st.scrollPos *= ratio;
         }
-        curDesc.clear();
-        curViewFunc();
-        if (curStates.size() != curDesc.size()) curStates.assign(curDesc.size(), State());
-        SDL_SetRenderTarget(renderer, currentTarget);
-        SDL_SetRenderDrawColor(renderer,255,255,255,255);
-        SDL_RenderClear(renderer);
-        int n = curDesc.size();
-        std::vector<SDL_Texture*> tex(n);
-        std::vector<SDL_Rect> rect(n);
-        std::vector<std::vector<Descriptor>> hchildren(n);
-        int totalH = 0;
-        for (int i = 0; i < n; i++) {
-            if (curDesc[i].type == DescType::Toggle) totalH += 68+2*V_PADDING+(i?SPACING:0);
-            else if (curDesc[i].type == DescType::TextField) totalH += TF_HEIGHT+(i?SPACING:0);
-            else if (curDesc[i].type == DescType::HStack) {
-                auto save=curDesc; curDesc.clear();
-                curDesc[i].cb();
-                hchildren[i]=curDesc;
-                curDesc=save;
-                int hh=0;
-                for(auto&d:hchildren[i]){
-                    int w,h;
-                    if (d.type==DescType::Text||d.type==DescType::Button||d.type==DescType::Title)
-                        TTF_SizeUTF8(d.type==DescType::Title?titleFont:font, d.label.c_str(), &w,&h),
-                        hh=std::max(hh,h);
-                }
-                totalH+=hh+(i?SPACING:0);
-            } else if (curDesc[i].type == DescType::Image) totalH += curDesc[i].imgH + (i?SPACING:0);
-            else if (curDesc[i].type == DescType::Title) {
-                int w,h;
-                TTF_SizeUTF8(titleFont,curDesc[i].label.c_str(),&w,&h);
-                totalH+=h+(i?SPACING:0);
-            } else { int w,h;TTF_SizeUTF8(font,curDesc[i].label.c_str(),&w,&h); totalH+=h+(i?SPACING:0); }
-        }
-        int y = (HEIGHT*SCALE - totalH)/2;
-        for (int i = 0; i < n; i++) {
-            if (curDesc[i].type == DescType::Toggle) {
-                rect[i] = {0,y,WIDTH*SCALE,68+2*V_PADDING};
-                y += 68+2*V_PADDING+SPACING;
-            } else if (curDesc[i].type == DescType::TextField) {
-                rect[i] = {TF_PADDING,y,WIDTH*SCALE-2*TF_PADDING,TF_HEIGHT};
-                y += TF_HEIGHT+SPACING;
-            } else if (curDesc[i].type == DescType::HStack) {
-                int hh=0;
-                for(auto&d:hchildren[i]){
-                    int w,h;
-                    if (d.type==DescType::Text||d.type==DescType::Button||d.type==DescType::Title)
-                        TTF_SizeUTF8(d.type==DescType::Title?titleFont:font, d.label.c_str(), &w,&h),
-                        hh=std::max(hh,h);
-                }
-                rect[i] = {0,y,WIDTH*SCALE,hh};
-                y += hh+SPACING;
-            } else if (curDesc[i].type == DescType::Image) {
-                rect[i] = {(WIDTH*SCALE - curDesc[i].imgW)/2, y, curDesc[i].imgW, curDesc[i].imgH};
-                y += curDesc[i].imgH + SPACING;
-            } else if (curDesc[i].type == DescType::Title) {
-                int w,h;
-                TTF_SizeUTF8(titleFont,curDesc[i].label.c_str(),&w,&h);
-                rect[i] = {(WIDTH*SCALE-w)/2,y,w,h};
-                y += h+SPACING;
-            } else {
-                int w,h;
-                TTF_SizeUTF8(font,curDesc[i].label.c_str(),&w,&h);
-                rect[i] = {(WIDTH*SCALE-w)/2,y,w,h};
-                y += h+SPACING;
-            }
+        Animations& a = ctx->tweens;
+        for (size_t i = 0; i < a.state.size(); i++) {
+            if (a.prop[i] != TweenProp::Scroll) continue;
+            a.from[i] *= ratio;
+            a.to[i] *= ratio;
+            a.value[i] *= ratio;
         }
-        for (int i = 0; i < n; i++) {
-            State& st = curStates[i];
-            if (curDesc[i].type == DescType::Button) {
-                bool d = mouseDown && downX>=rect[i].x&&downX<=rect[i].x+rect[i].w&&downY>=rect[i].y&&downY<=rect[i].y+rect[i].h;
-                bool u = mouseUp   && upX  >=rect[i].x&& upX <=rect[i].x+rect[i].w&& upY>=rect[i].y&& upY<=rect[i].y+rect[i].h;
-                if (d) { curDesc[i].cb(); st.pressed=true;st.animating=false;st.alpha=PRESSED_ALPHA; }
-                if (mouseUp&&st.pressed) { st.pressed=false; if(u){st.animating=true;st.animStart=SDL_GetTicks();}else st.alpha=NORMAL_ALPHA; }
-                if (st.animating) {
-                    float dt=float(SDL_GetTicks()-st.animStart)/ANIM_DURATION;
-                    if (dt>=1) { st.animating=false; st.alpha=NORMAL_ALPHA; }
-                    else { float v=springValues[size_t(dt*(springValues.size()-1))]; st.alpha=PRESSED_ALPHA+(NORMAL_ALPHA-PRESSED_ALPHA)*v; }
-                }
-                SDL_Color col={0,102,255,255};
-                SDL_Surface* surf=TTF_RenderUTF8_Blended(font,curDesc[i].label.c_str(),col);
-                tex[i]=SDL_CreateTextureFromSurface(renderer,surf);
-                SDL_FreeSurface(surf);
-                SDL_SetTextureAlphaMod(tex[i],Uint8(st.alpha*255));
-                SDL_RenderCopy(renderer,tex[i],nullptr,&rect[i]);
-                SDL_DestroyTexture(tex[i]);
-            } else if (curDesc[i].type == DescType::Text) {
-                SDL_Color col={0,0,0,255};
-                SDL_Surface* surf=TTF_RenderUTF8_Blended(font,curDesc[i].label.c_str(),col);
-                tex[i]=SDL_CreateTextureFromSurface(renderer,surf);
-                SDL_FreeSurface(surf);
-                SDL_RenderCopy(renderer,tex[i],nullptr,&rect[i]);
-                SDL_DestroyTexture(tex[i]);
-            } else if (curDesc[i].type == DescType::Title) {
-                SDL_Color col={0,0,0,255};
-                SDL_Surface* surf=TTF_RenderUTF8_Blended(titleFont,curDesc[i].label.c_str(),col);
-                tex[i]=SDL_CreateTextureFromSurface(renderer,surf);
-                SDL_FreeSurface(surf);
-                SDL_RenderCopy(renderer,tex[i],nullptr,&rect[i]);
-                SDL_DestroyTexture(tex[i]);
-            } else if (curDesc[i].type == DescType::Toggle) {
-                int ty=rect[i].y;
-                int w,h;TTF_SizeUTF8(font,curDesc[i].label.c_str(),&w,&h);
-                SDL_Surface* surf=TTF_RenderUTF8_Blended(font,curDesc[i].label.c_str(),SDL_Color{0,0,0,255});
-                SDL_Texture* labelTex=SDL_CreateTextureFromSurface(renderer,surf);
-                SDL_FreeSurface(surf);
-                SDL_Rect lr={5*SCALE,ty+V_PADDING+(68-h)/2,w,h};
-                SDL_RenderCopy(renderer,labelTex,nullptr,&lr);
-                SDL_DestroyTexture(labelTex);
-                int tx=WIDTH*SCALE-5*SCALE-132, ty0=ty+V_PADDING;
-                bool& s=*curDesc[i].toggleState;
-                int toggW=132,toggH=68,innerPad=5*SCALE;
-                int circleD=toggH-2*innerPad;
-                bool dT=mouseDown&&downX>=tx&&downX<=tx+toggW&&downY>=ty0&&downY<=ty0+toggH;
-                bool uT=mouseUp&&upX>=tx&&upX<=tx+toggW&&upY>=ty0&&upY<=ty0+toggH;
-                if(dT){st.togPressed=true;st.togPending=true;st.togTarget=!s;}
-                if(mouseUp&&st.togPressed){st.togPressed=false; if(uT){st.togAnimating=true;st.togStart=SDL_GetTicks();}else st.togPending=false;}
-                if(!st.togAnimating) st.togPos=s?1.0f:0.0f;
-                if(st.togAnimating){
-                    float dt=float(SDL_GetTicks()-st.togStart)/ANIM_DURATION;
-                    if(dt>=1){st.togAnimating=false; if(st.togPending) s=st.togTarget; st.togPending=false; st.togPos=s?1.0f:0.0f;}
-                    else{float r=springValues[size_t(dt*(springValues.size()-1))];st.togPos=st.togTarget?r:(1-r);}
-                }
-                float vPos=st.togPos;
-                SDL_SetRenderDrawBlendMode(renderer,SDL_BLENDMODE_BLEND);
-                Uint8 r0=0xe9,g0=0xe9,b0=0xeb;
-                Uint8 r1=0x69,g1=0xce,b1=0x67;
-                Uint8 rc=Uint8(r0+(r1-r0)*vPos), gc=Uint8(g0+(g1-g0)*vPos), bc=Uint8(b0+(b1-b0)*vPos);
-                roundedBoxRGBA(renderer,tx,ty0,tx+toggW-1,ty0+toggH-1,toggH/2,rc,gc,bc,255);
-                int cx=tx+innerPad+int((toggW-2*innerPad-circleD)*vPos), cy=ty0+innerPad;
-                filledCircleRGBA(renderer,cx+circleD/2,cy+circleD/2,circleD/2,0xff,0xff,0xff,255);
-            } else if (curDesc[i].type == DescType::TextField) {
-                State& stf = curStates[i];
-                roundedBoxRGBA(renderer,rect[i].x,rect[i].y,rect[i].x+rect[i].w,rect[i].y+rect[i].h,TF_RADIUS,255,255,255,255);
-                roundedRectangleRGBA(renderer,rect[i].x,rect[i].y,rect[i].x+rect[i].w,rect[i].y+rect[i].h,TF_RADIUS,0x88,0x88,0x88,255);
-                std::string* txt = curDesc[i].textState;
-                bool empty = txt->empty();
-                SDL_Color tcol=empty?SDL_Color{0x88,0x88,0x88,255}:SDL_Color{0,0,0,255};
-                SDL_Surface* surf=TTF_RenderUTF8_Blended(font,(empty?curDesc[i].label:*txt).c_str(),tcol);
-                SDL_Texture* ttx=SDL_CreateTextureFromSurface(renderer,surf);
-                int th=surf->h, tw=surf->w;
-                SDL_FreeSurface(surf);
-                SDL_Rect tr={rect[i].x+5,rect[i].y+(TF_HEIGHT-th)/2,tw,th};
-                SDL_RenderCopy(renderer,ttx,nullptr,&tr);
-                SDL_DestroyTexture(ttx);
-                Uint32 now=SDL_GetTicks();
-                if(stf.tfFocused){
-                    if(now-stf.lastBlink>CURSOR_BLINK_INTERVAL){
-                        stf.showCursor=!stf.showCursor;
-                        stf.lastBlink=now;
-                    }
-                    if(stf.showCursor){
-                        int caretX=empty?rect[i].x+5:tr.x+tw;
-                        int cy0=rect[i].y+4, cy1=rect[i].y+TF_HEIGHT-4;
-                        SDL_RenderDrawLine(renderer,caretX,cy0,caretX,cy1);
-                    }
-                }
-            } else if (curDesc[i].type == DescType::HStack) {
-                auto& tmp = hchildren[i];
-                int cnt = tmp.size();
-                if (!cnt) continue;
-                int slotW = WIDTH * SCALE / cnt;
-                for (int j = 0; j < cnt; j++) {
-                    auto& d = tmp[j];
-                    int x0 = j * slotW;
-                    int y0 = rect[i].y;
-                    if (d.type == DescType::Text || d.type == DescType::Button || d.type == DescType::Title) {
-                        SDL_Color col = d.type==DescType::Button?SDL_Color{0,102,255,255}:SDL_Color{0,0,0,255};
-                        TTF_Font* f = d.type==DescType::Title? titleFont : font;
-                        SDL_Surface* surf = TTF_RenderUTF8_Blended(f, d.label.c_str(), col);
-                        SDL_Texture* txr = SDL_CreateTextureFromSurface(renderer, surf);
-                        int w,h; SDL_QueryTexture(txr,nullptr,nullptr,&w,&h);
-                        SDL_FreeSurface(surf);
-                        SDL_Rect rr = {x0 + (slotW-w)/2, y0 + (rect[i].h-h)/2, w,h};
-                        SDL_RenderCopy(renderer, txr, nullptr, &rr);
-                        SDL_DestroyTexture(txr);
-                    }
-                }
-            } else if (curDesc[i].type == DescType::Image) {
-                SDL_Surface* surf = IMG_Load(("./Resources/" + curDesc[i].label).c_str());
-                SDL_Texture* imgTex = SDL_CreateTextureFromSurface(renderer, surf);
-                SDL_FreeSurface(surf);
-                SDL_RenderCopy(renderer, imgTex, nullptr, &rect[i]);
-                SDL_DestroyTexture(imgTex);
+        ctx->scale = scale;
+        ctx->font = openFont(FONT_FILE, px(FONT_SIZE));
+        ctx->titleFont = openFont(FONT_FILE, px(TITLE_FONT_SIZE));
+#if SERVIETTUI_GLYPH_ATLAS
+        clearGlyphAtlas();
+#endif
+        clearTextCache();
+    }
+    ctx->density = density;
+    ctx->fullRepaint = true;
+    return true;
+}
+
+Context* OpenWindow(const std::string& title, const std::function<void()>& viewFunc) {
+    if (contexts.empty()) startFramework();
+    Context* caller = ctx;
+    Context* c = new Context();
+    useContext(c);
+    c->window = SDL_CreateWindow(title.c_str(), SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED, DEFAULT_WIDTH, DEFAULT_HEIGHT, SDL_WINDOW_ALLOW_HIGHDPI | SDL_WINDOW_RESIZABLE);
+    Uint32 vsyncFlag = vsync ? SDL_RENDERER_PRESENTVSYNC : 0;
+    c->renderer = SDL_CreateRenderer(c->window, -1, SDL_RENDERER_ACCELERATED | SDL_RENDERER_TARGETTEXTURE | vsyncFlag);
+    if (!c->renderer) c->renderer = SDL_CreateRenderer(c->window, -1, SDL_RENDERER_SOFTWARE | SDL_RENDERER_TARGETTEXTURE | vsyncFlag);
+    updateMetrics();
+    // Window coordinates are pixels here, so give the window its size in points.
+    if (c->scale != c->density) {
+        SDL_SetWindowSize(c->window, int(DEFAULT_WIDTH * c->scale / c->density), int(DEFAULT_HEIGHT * c->scale / c->density));
+        updateMetrics();
+    }
+    c->curViewFunc = viewFunc;
+    buildView(c->curViewFunc, c->curDesc, c->curStates);
+    layoutView(c->curDesc, c->curStates, c->curNodes);
+    buildHitIndex(c->curNodes, c->curStates.size());
+    contexts.push_back(c);
+    useContext(caller);
+    return c;
+}
+
+void CloseWindow(Context* window) {
+    if (window) window->closing = true;
+}
+
+static void closeContext(Context* c) {
+    useContext(c);
+    stopPipeline();
+    clearImageCache();
+    clearPrimitives();
+#if SERVIETTUI_GLYPH_ATLAS
+    clearGlyphAtlas();
+#endif
+    clearTextCache();
+    clearSnapshots();
+    clearTexturePool();
+    if (c->slideFrom && c->slideOwned) SDL_DestroyTexture(c->slideFrom);
+    if (c->nextTarget) SDL_DestroyTexture(c->nextTarget);
+    SDL_DestroyTexture(c->currentTarget);
+    SDL_DestroyRenderer(c->renderer);
+    SDL_DestroyWindow(c->window);
+    contexts.erase(std::find(contexts.begin(), contexts.end(), c));
+    useContext(nullptr);
+    delete c;
+}
+
+// Window an input or window event is addressed to, or 0 if it concerns
+// every window.
+static Uint32 eventWindow(const SDL_Event& e) {
+    if (e.type == invalidateEvent) return e.user.windowID;
+    switch (e.type) {
+    case SDL_WINDOWEVENT: return e.window.windowID;
+    case SDL_MOUSEBUTTONDOWN:
+    case SDL_MOUSEBUTTONUP: return e.button.windowID;
+    case SDL_MOUSEMOTION: return e.motion.windowID;
+    case SDL_MOUSEWHEEL: return e.wheel.windowID;
+    case SDL_TEXTINPUT: return e.text.windowID;
+    case SDL_KEYDOWN:
+    case SDL_KEYUP: return e.key.windowID;
+    default: return 0;
+    }
+}
+
+// Hands an event to the window it belongs to, waking it for a frame.
+static void routeEvent(const SDL_Event& e) {
+    Uint32 id = eventWindow(e);
+    for (Context* c : contexts) {
+        if (id && SDL_GetWindowID(c->window) != id) continue;
+        c->woken = true;
+        if (e.type == SDL_QUIT) c->closing = true;
+        if (e.type == SDL_WINDOWEVENT && e.window.event == SDL_WINDOWEVENT_CLOSE) c->closing = true;
+        if (e.type == SDL_WINDOWEVENT && e.window.event == SDL_WINDOWEVENT_EXPOSED) c->fullRepaint = true;
+        if (e.type == SDL_WINDOWEVENT && e.window.event == SDL_WINDOWEVENT_SIZE_CHANGED) c->resized = true;
+#if SDL_VERSION_ATLEAST(2,0,18)
+        if (e.type == SDL_WINDOWEVENT && e.window.event == SDL_WINDOWEVENT_DISPLAY_CHANGED) c->resized = true;
+#endif
+        if (e.type == SDL_RENDER_TARGETS_RESET || e.type == SDL_RENDER_DEVICE_RESET) c->fullRepaint = true;
+        useContext(c);
+        queueInput(e);
+    }
+}
+
+// One pass of the UI loop for the current window: input, build, layout,
+// update, paint and present. woken tells whether events arrived for it.
+// Returns whether the pass presented.
+static bool runFrame(bool woken) {
+    ctx->frameStats = FrameStats();
+    Uint64 frameStart = SDL_GetPerformanceCounter(), phase = frameStart;
+    double inputAt = -1;
+    if (finishPipeline()) {
+        adoptPipeline();
+        inputAt = ctx->workInputAt;
+    }
+    // A frame the worker laid out before a resize is laid out again here.
+    bool relayout = ctx->resized && updateMetrics();
+    ctx->resized = false;
+    // A pipelined frame shows the input handled one frame earlier, so
+    // any event means one more frame to paint.
+    ctx->redraw = pipelined && woken;
+    double newInputAt = -1;
+    // Pipelined, this hit-tests against the adopted layout, see above.
+    for (const InputEvent& ev : ctx->inputQueue) {
+        if (newInputAt < 0 || ev.at < newInputAt) newInputAt = ev.at;
+        dispatchInput(ev, ctx->curNodes, ctx->curStates);
+    }
+    ctx->frameStats.inputEvents = int(ctx->inputQueue.size());
+    ctx->inputQueue.clear();
+    TRACE_SPAN("input", frameStart);
+    ctx->frameStats.input = lapMs(phase);
+    // Tweens are applied before the build, so the layout below places lists
+    // at this frame's scroll offsets and sees committed toggles.
+    double update = 0;
+    {
+        TRACE_SCOPE("animate");
+        advanceTweens(ctx->tweens, frameNow);
+        if (applyTweens(ctx->curDesc, ctx->curStates)) ctx->redraw = true;
+        update = lapMs(phase);
+    }
+    if (!pipelined || relayout) {
+        std::vector<int> moved;
+        if (buildView(ctx->curViewFunc, ctx->curDesc, ctx->curStates, &moved)) remapInput(moved);
+        ctx->frameStats.build = lapMs(phase);
+        layoutView(ctx->curDesc, ctx->curStates, ctx->curNodes);
+        buildHitIndex(ctx->curNodes, ctx->curStates.size());
+        ctx->frameStats.layout = lapMs(phase);
+        inputAt = newInputAt;
+    }
+    {
+        TRACE_SCOPE("update");
+        updateWidgets(ctx->curNodes, ctx->curStates);
+    }
+    ctx->frameStats.update = update + lapMs(phase);
+    checkImageFiles(ctx->curNodes, frameNow);
+    if (uploadImages()) ctx->redraw = true;
+    if (pipelined) {
+        ctx->workInputAt = newInputAt;
+        startPipeline();
+        if (!pipelined) ctx->redraw = true;
+    }
+    std::vector<SDL_Rect>& damage = ctx->damage;
+    recordPaint(ctx->curNodes, ctx->curStates, ctx->frameRecords);
+    if (ctx->fullRepaint) damage.assign(1, SDL_Rect{0, 0, ctx->width, ctx->height});
+    else collectDamage(ctx->paintedRecords, ctx->frameRecords, damage);
+    ctx->fullRepaint = false;
+    if (!damage.empty()) repaintDamage(ctx->currentTarget, ctx->curNodes, ctx->curStates, damage);
+    ctx->paintedRecords.swap(ctx->frameRecords);
+    bool present = !damage.empty() || ctx->animatingOverlay || ctx->transitionPending;
+    if (ctx->transitionPending) {
+        finishPipeline();
+        beginTransition();
+    }
+    ctx->frameStats.paint = lapMs(phase);
+    if (present) {
+        TRACE_SCOPE("present");
+        SDL_RenderClear(ctx->renderer);
+        if (ctx->animatingOverlay) {
+            float dt = float(frameNow - ctx->overlayStart)/ctx->transitionSpring.duration;
+            float v2 = springSample(ctx->transitionSpring, dt);
+            if (dt>=1) ctx->animatingOverlay = false;
+            // Going back runs the push slide in reverse, with the views swapped.
+            float p = ctx->slideBack ? 1 - v2 : v2;
+            SDL_Texture* under = ctx->slideBack ? ctx->currentTarget : ctx->slideFrom;
+            SDL_Texture* over = ctx->slideBack ? ctx->slideFrom : ctx->currentTarget;
+            int offUnder = int(-0.5f * ctx->width * p);
+            int offOver = int(ctx->width * (1 - p));
+            SDL_Rect dstUnder = {offUnder,0,ctx->width,ctx->height};
+            if (under) SDL_RenderCopy(ctx->renderer,under,nullptr,&dstUnder);
+            SDL_SetRenderDrawBlendMode(ctx->renderer,SDL_BLENDMODE_BLEND);
+            SDL_SetRenderDrawColor(ctx->renderer,0,0,0,Uint8(OVERLAY_MAX_ALPHA*p*255));
+            SDL_RenderFillRect(ctx->renderer,&dstUnder);
+            SDL_SetRenderDrawBlendMode(ctx->renderer,SDL_BLENDMODE_NONE);
+            SDL_Rect dstOver = {offOver,0,ctx->width,ctx->height};
+            if (over) SDL_RenderCopy(ctx->renderer,over,nullptr,&dstOver);
+            if (!ctx->animatingOverlay) {
+                endSlide();
+                trimSnapshots();
             }
-        }
-        SDL_SetRenderTarget(renderer,nullptr);
-        SDL_RenderClear(renderer);
-        if (animatingOverlay) {
-            float dt = float(SDL_GetTicks() - overlayStart)/ANIM_DURATION;
-            float t = dt>1?1:dt;
-            float v2 = springValues[size_t(t*(springValues.size()-1))];
-            if (dt>=1) animatingOverlay = false;
-            int offOld = int(-0.5f * WIDTH * SCALE * v2);
-            int offNew = int(WIDTH * SCALE * (1 - v2));
-            SDL_Rect dstOld = {offOld,0,WIDTH*SCALE,HEIGHT*SCALE};
-            SDL_RenderCopy(renderer,nextTarget,nullptr,&dstOld);
-            SDL_SetRenderDrawBlendMode(renderer,SDL_BLENDMODE_BLEND);
-            SDL_SetRenderDrawColor(renderer,0,0,0,Uint8(OVERLAY_MAX_ALPHA*v2*255));
-            SDL_RenderFillRect(renderer,&dstOld);
-            SDL_SetRenderDrawBlendMode(renderer,SDL_BLENDMODE_NONE);
-            SDL_Rect dstNew = {offNew,0,WIDTH*SCALE,HEIGHT*SCALE};
-            SDL_RenderCopy(renderer,currentTarget,nullptr,&dstNew);
         } else {
-            SDL_RenderCopy(renderer,currentTarget,nullptr,nullptr);
+            SDL_RenderCopy(ctx->renderer,ctx->currentTarget,nullptr,nullptr);
         }
-        SDL_RenderPresent(renderer);
-        Uint32 elapsed = SDL_GetTicks() - start;
-        if (elapsed < FRAME_DELAY) SDL_Delay(FRAME_DELAY - elapsed);
+        SDL_RenderPresent(ctx->renderer);
+        double presentedAt = clockMs();
+        recordPresent(presentedAt, ctx->busy);
+        if (inputAt >= 0) ctx->frameStats.inputLatency = presentedAt - inputAt;
+    }
+    recycleTextures();
+    ctx->frameStats.present = lapMs(phase);
+    ctx->frameStats.presented = present;
+    ctx->frameStats.total = lapMs(frameStart);
+    TRACE_SPAN("frame", frameStart);
+    TRACE_COUNTER("texturesCreated", ctx->frameStats.texturesCreated);
+    TRACE_COUNTER("textRasterized", ctx->frameStats.textRasterized);
+    TRACE_COUNTER("textMeasured", ctx->frameStats.textMeasured);
+    TRACE_COUNTER("descriptorsBuilt", ctx->frameStats.descriptorsBuilt);
+    TRACE_COUNTER("inputEvents", ctx->frameStats.inputEvents);
+    if (frameCallback) frameCallback(ctx->frameStats);
+    return present;
+}
+
+// Waits for events, routes them to their windows and runs a pass for every
+// window that got events or has something moving. Frames of all windows are
+// paced together.
+void RunWindows() {
+    SDL_StartTextInput();
+    SDL_Event e;
+    while (!contexts.empty()) {
+        int timeout = -1;
+        for (Context* c : contexts) {
+            useContext(c);
+            c->busy = renderMode == RenderMode::Continuous || c->redraw || isAnimating();
+            int wait = c->busy ? 0 : idleTimeout(c->curNodes, c->curStates);
+            // A window with nothing moving renders ahead one prefetched view
+            // per pass, so events are still handled between them.
+            if (!c->closing && !c->woken && !c->redraw && !isAnimating() && prefetchView()) wait = 0;
+            if (wait >= 0 && (timeout < 0 || wait < timeout)) timeout = wait;
+        }
+        bool pending = timeout == 0 ? SDL_PollEvent(&e) : timeout < 0 ? SDL_WaitEvent(&e) : SDL_WaitEventTimeout(&e, timeout);
+        frameNow = clockMs();
+        for (; pending; pending = SDL_PollEvent(&e)) routeEvent(e);
+        bool presented = false, paced = false;
+        for (size_t i = 0; i < contexts.size(); i++) {
+            Context* c = contexts[i];
+            if (c->closing) continue;
+            useContext(c);
+            // An idle window also runs a pass once its caret blink or image
+            // check is due, which is what the wait timed out for.
+            if (!c->busy && !c->woken && idleTimeout(c->curNodes, c->curStates) != 0) continue;
+            bool woken = c->woken;
+            c->woken = false;
+            if (runFrame(woken)) presented = true;
+            if (renderMode == RenderMode::Continuous || isAnimating()) paced = true;
+        }
+        for (size_t i = contexts.size(); i-- > 0;)
+            if (contexts[i]->closing) closeContext(contexts[i]);
+        useContext(nullptr);
+        if (paced) waitForNextFrame(presented);
+        else nextDeadline = clockMs();
     }
     SDL_StopTextInput();
-    SDL_DestroyTexture(nextTarget);
-    SDL_DestroyTexture(currentTarget);
-    TTF_CloseFont(titleFont);
-    TTF_CloseFont(font);
-    SDL_DestroyRenderer(renderer);
-    SDL_DestroyWindow(window);
-    IMG_Quit();
-    TTF_Quit();
-    SDL_Quit();
+    stopFramework();
+}
+
+void View(const std::function<void()>& viewFunc) {
+    OpenWindow("serviettUI", viewFunc);
+    RunWindows();
 }
@@ -0,0 +1,24 @@
+#include "spring.h"
+#include <map>
+#include <utility>
+
+// Curves for non-default springs, built on first use.
+static std::map<std::pair<float, float>, SpringCurve> springCurves;
+
+const SpringCurve& springCurve(const Spring& s) {
+    if (s.damping == Spring().damping && s.stiffness == Spring().stiffness) return DEFAULT_SPRING_CURVE;
+    auto key = std::make_pair(s.damping, s.stiffness);
+    auto it = springCurves.find(key);
+    if (it == springCurves.end()) it = springCurves.emplace(key, makeSpringCurve(s.damping, s.stiffness)).first;
+    return it->second;
+}
+
+float springSample(const Spring& s, float t) {
+    if (t <= 0) return 0;
+    if (t >= 1) return 1;
+    const SpringCurve& c = springCurve(s);
+    float pos = t * SPRING_SAMPLES;
+    int i = int(pos);
+    float frac = pos - float(i);
+    return c.v[i] + (c.v[i + 1] - c.v[i]) * frac;
+}
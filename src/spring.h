@@ -0,0 +1,74 @@
+// spring.h
+#pragma once
+#include "serviettUI.h"
+#include <array>
+
+// Closed-form step response of the damped oscillator
+//     x'' + 2 * damping * x' + stiffness * x = 0
+// starting at rest, the same model animations/spring.py samples. Curves are
+// normalized so they reach exactly 1 at the end of the animation.
+static constexpr int SPRING_SAMPLES = 256;
+
+constexpr double springSqrt(double x) {
+    if (x <= 0) return 0;
+    double r = x > 1 ? x : 1;
+    for (int i = 0; i < 64; i++) r = 0.5 * (r + x / r);
+    return r;
+}
+
+constexpr double springExp(double x) {
+    int halvings = 0;
+    while (x > 0.5 || x < -0.5) { x /= 2; halvings++; }
+    double term = 1, sum = 1;
+    for (int i = 1; i < 20; i++) { term *= x / i; sum += term; }
+    while (halvings-- > 0) sum *= sum;
+    return sum;
+}
+
+constexpr double springSin(double x) {
+    constexpr double PI = 3.14159265358979323846;
+    while (x > PI) x -= 2 * PI;
+    while (x < -PI) x += 2 * PI;
+    double term = x, sum = x;
+    for (int i = 1; i < 12; i++) { term *= -x * x / ((2 * i) * (2 * i + 1)); sum += term; }
+    return sum;
+}
+
+constexpr double springCos(double x) {
+    return springSin(x + 3.14159265358979323846 / 2);
+}
+
+// Displacement at time t (in seconds of model time, 0..1 spans the whole
+// animation) for a unit step.
+constexpr double springStep(double damping, double stiffness, double t) {
+    double w0 = springSqrt(stiffness);
+    if (damping > w0) {
+        double root = springSqrt(damping * damping - stiffness);
+        double r1 = -damping + root, r2 = -damping - root;
+        double c2 = r1 / (r1 - r2), c1 = 1 - c2;
+        return 1 - c1 * springExp(r1 * t) - c2 * springExp(r2 * t);
+    }
+    if (damping == w0) return 1 - (1 + damping * t) * springExp(-damping * t);
+    double wd = springSqrt(stiffness - damping * damping);
+    return 1 - springExp(-damping * t) * (springCos(wd * t) + damping / wd * springSin(wd * t));
+}
+
+struct SpringCurve {
+    std::array<float, SPRING_SAMPLES + 1> v{};
+};
+
+constexpr SpringCurve makeSpringCurve(double damping, double stiffness) {
+    SpringCurve c;
+    double end = springStep(damping, stiffness, 1.0);
+    if (end == 0) end = 1;
+    for (int i = 0; i <= SPRING_SAMPLES; i++)
+        c.v[i] = float(springStep(damping, stiffness, double(i) / SPRING_SAMPLES) / end);
+    return c;
+}
+
+static constexpr SpringCurve DEFAULT_SPRING_CURVE = makeSpringCurve(Spring().damping, Spring().stiffness);
+
+// Sampled curve of spring s.
+const SpringCurve& springCurve(const Spring& s);
+// Progress of an animation using spring s, t in [0, 1] of its duration.
+float springSample(const Spring& s, float t);
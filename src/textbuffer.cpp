@@ -0,0 +1,158 @@
+#include "serviettUI.h"
+#include <cstring>
+
+// Bytes of gap added whenever the buffer grows, on top of doubling.
+static constexpr size_t MIN_GAP = 256;
+
+static bool isContinuation(char c) {
+    return (c & 0xC0) == 0x80;
+}
+
+TextBuffer::TextBuffer(const std::string& text) {
+    setText(text);
+}
+
+size_t TextBuffer::size() const {
+    return data.size() - (gapEnd - gapStart);
+}
+
+std::string TextBuffer::text() const {
+    std::string out;
+    copyRange(0, size(), out);
+    return out;
+}
+
+void TextBuffer::setText(const std::string& text) {
+    data.assign(text.begin(), text.end());
+    data.resize(text.size() + MIN_GAP);
+    gapStart = text.size();
+    gapEnd = data.size();
+    linesBefore.assign(1, 0);
+    linesAfter.clear();
+    for (size_t i = 0; i < text.size(); i++)
+        if (text[i] == '\n') linesBefore.push_back(i + 1);
+    caretPos = anchorPos = text.size();
+}
+
+char TextBuffer::byteAt(size_t pos) const {
+    return pos < gapStart ? data[pos] : data[pos + gapEnd - gapStart];
+}
+
+void TextBuffer::copyRange(size_t from, size_t to, std::string& out) const {
+    out.clear();
+    if (from < gapStart) out.append(&data[from], std::min(to, gapStart) - from);
+    if (to > gapStart) {
+        size_t start = std::max(from, gapStart);
+        out.append(&data[start + gapEnd - gapStart], to - start);
+    }
+}
+
+// Moves the gap to pos, carrying the line starts it passes to the other side.
+void TextBuffer::moveGap(size_t pos) {
+    size_t total = size();
+    if (pos < gapStart) {
+        size_t n = gapStart - pos;
+        std::memmove(data.data() + gapEnd - n, data.data() + pos, n);
+        gapStart -= n;
+        gapEnd -= n;
+        while (linesBefore.back() > pos) {
+            linesAfter.push_back(total - linesBefore.back());
+            linesBefore.pop_back();
+        }
+    } else if (pos > gapStart) {
+        size_t n = pos - gapStart;
+        std::memmove(data.data() + gapStart, data.data() + gapEnd, n);
+        gapStart += n;
+        gapEnd += n;
+        while (!linesAfter.empty() && total - linesAfter.back() <= pos) {
+            linesBefore.push_back(total - linesAfter.back());
+            linesAfter.pop_back();
+        }
+    }
+}
+
+void TextBuffer::reserveGap(size_t bytes) {
+    if (gapEnd - gapStart >= bytes) return;
+    size_t after = data.size() - gapEnd;
+    size_t capacity = std::max(data.size() * 2, size() + bytes + MIN_GAP);
+    std::vector<char> grown(capacity);
+    std::memcpy(grown.data(), data.data(), gapStart);
+    std::memcpy(grown.data() + capacity - after, data.data() + gapEnd, after);
+    data.swap(grown);
+    gapEnd = capacity - after;
+}
+
+void TextBuffer::eraseRange(size_t from, size_t to) {
+    moveGap(from);
+    for (size_t i = gapEnd; i < gapEnd + (to - from); i++)
+        if (data[i] == '\n') linesAfter.pop_back();
+    gapEnd += to - from;
+    caretPos = anchorPos = from;
+}
+
+void TextBuffer::setCaret(size_t pos, bool extend) {
+    pos = std::min(pos, size());
+    while (pos > 0 && pos < size() && isContinuation(byteAt(pos))) pos--;
+    caretPos = pos;
+    if (!extend) anchorPos = pos;
+}
+
+std::string TextBuffer::selectedText() const {
+    std::string out;
+    copyRange(selectionStart(), selectionEnd(), out);
+    return out;
+}
+
+void TextBuffer::insert(const std::string& text) {
+    if (hasSelection()) eraseRange(selectionStart(), selectionEnd());
+    moveGap(caretPos);
+    reserveGap(text.size());
+    std::memcpy(data.data() + gapStart, text.data(), text.size());
+    for (size_t i = 0; i < text.size(); i++)
+        if (text[i] == '\n') linesBefore.push_back(gapStart + i + 1);
+    gapStart += text.size();
+    caretPos = anchorPos = gapStart;
+}
+
+void TextBuffer::erase(bool forward) {
+    if (hasSelection()) eraseRange(selectionStart(), selectionEnd());
+    else if (forward && caretPos < size()) eraseRange(caretPos, nextChar(caretPos));
+    else if (!forward && caretPos > 0) eraseRange(prevChar(caretPos), caretPos);
+}
+
+size_t TextBuffer::lineCount() const {
+    return linesBefore.size() + linesAfter.size();
+}
+
+size_t TextBuffer::lineStart(size_t line) const {
+    if (line < linesBefore.size()) return linesBefore[line];
+    return size() - linesAfter[linesAfter.size() - 1 - (line - linesBefore.size())];
+}
+
+size_t TextBuffer::lineEnd(size_t line) const {
+    return line + 1 < lineCount() ? lineStart(line + 1) - 1 : size();
+}
+
+size_t TextBuffer::lineOf(size_t pos) const {
+    auto after = std::lower_bound(linesAfter.begin(), linesAfter.end(), size() - std::min(pos, size()));
+    if (after != linesAfter.end()) return linesBefore.size() + size_t(linesAfter.end() - after) - 1;
+    return size_t(std::upper_bound(linesBefore.begin(), linesBefore.end(), pos) - linesBefore.begin()) - 1;
+}
+
+void TextBuffer::line(size_t line, std::string& out) const {
+    copyRange(lineStart(line), lineEnd(line), out);
+}
+
+size_t TextBuffer::prevChar(size_t pos) const {
+    if (pos == 0) return 0;
+    pos--;
+    while (pos > 0 && isContinuation(byteAt(pos))) pos--;
+    return pos;
+}
+
+size_t TextBuffer::nextChar(size_t pos) const {
+    if (pos >= size()) return size();
+    pos++;
+    while (pos < size() && isContinuation(byteAt(pos))) pos++;
+    return pos;
+}
@@ -0,0 +1,85 @@
+// trace.cpp
+#include "trace.h"
+#include "serviettUI.h"
+
+#if SERVIETTUI_TRACE
+#include <atomic>
+#include <cstdio>
+
+static constexpr Uint64 TRACE_CAPACITY = 1 << 15;
+
+enum class TraceKind : Uint32 { Span, Counter };
+
+// One event. seq is 2 * index + 1 while a writer fills the slot and
+// 2 * index + 2 once it is complete, so a reader can tell a finished event
+// from a torn or overwritten one without taking a lock.
+struct TraceSlot {
+    std::atomic<Uint64> seq{0};
+    std::atomic<const char*> name{nullptr};
+    std::atomic<Uint32> kind{0};
+    std::atomic<Uint64> thread{0};
+    std::atomic<Uint64> start{0};
+    std::atomic<Uint64> value{0};
+};
+
+static TraceSlot traceRing[TRACE_CAPACITY];
+static std::atomic<Uint64> traceHead{0};
+
+static void record(const char* name, TraceKind kind, Uint64 start, Uint64 value) {
+    Uint64 index = traceHead.fetch_add(1, std::memory_order_relaxed);
+    TraceSlot& s = traceRing[index % TRACE_CAPACITY];
+    s.seq.store(2 * index + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    s.name.store(name, std::memory_order_relaxed);
+    s.kind.store(Uint32(kind), std::memory_order_relaxed);
+    s.thread.store(SDL_ThreadID(), std::memory_order_relaxed);
+    s.start.store(start, std::memory_order_relaxed);
+    s.value.store(value, std::memory_order_relaxed);
+    s.seq.store(2 * index + 2, std::memory_order_release);
+}
+
+void traceSpan(const char* name, Uint64 start, Uint64 end) {
+    record(name, TraceKind::Span, start, end - start);
+}
+
+void traceCounter(const char* name, Uint64 value) {
+    record(name, TraceKind::Counter, SDL_GetPerformanceCounter(), value);
+}
+
+// Writes every complete event still in the ring, oldest first. Events that
+// are being written or were overwritten while dumping are skipped.
+bool DumpTrace(const std::string& path) {
+    FILE* out = std::fopen(path.c_str(), "w");
+    if (!out) return false;
+    double usPerTick = 1e6 / double(SDL_GetPerformanceFrequency());
+    Uint64 head = traceHead.load(std::memory_order_acquire);
+    Uint64 first = head > TRACE_CAPACITY ? head - TRACE_CAPACITY : 0;
+    std::fprintf(out, "{\"traceEvents\":[");
+    bool comma = false;
+    for (Uint64 i = first; i < head; i++) {
+        TraceSlot& s = traceRing[i % TRACE_CAPACITY];
+        if (s.seq.load(std::memory_order_acquire) != 2 * i + 2) continue;
+        const char* name = s.name.load(std::memory_order_relaxed);
+        TraceKind kind = TraceKind(s.kind.load(std::memory_order_relaxed));
+        Uint64 thread = s.thread.load(std::memory_order_relaxed);
+        Uint64 start = s.start.load(std::memory_order_relaxed);
+        Uint64 value = s.value.load(std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (s.seq.load(std::memory_order_relaxed) != 2 * i + 2) continue;
+        std::fprintf(out, comma ? ",\n" : "\n");
+        comma = true;
+        if (kind == TraceKind::Span)
+            std::fprintf(out, "{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%llu,\"ts\":%.3f,\"dur\":%.3f}",
+                         name, (unsigned long long)thread, start * usPerTick, value * usPerTick);
+        else
+            std::fprintf(out, "{\"name\":\"%s\",\"ph\":\"C\",\"pid\":1,\"tid\":%llu,\"ts\":%.3f,\"args\":{\"value\":%llu}}",
+                         name, (unsigned long long)thread, start * usPerTick, (unsigned long long)value);
+    }
+    std::fprintf(out, "\n]}\n");
+    return std::fclose(out) == 0;
+}
+#else
+bool DumpTrace(const std::string&) {
+    return false;
+}
+#endif
@@ -0,0 +1,34 @@
+// trace.h
+#pragma once
+#include <SDL.h>
+
+// Scoped spans and counters for the UI loop, recorded into a fixed ring
+// buffer and exported as Chrome trace JSON (chrome://tracing or
+// ui.perfetto.dev). Build with -DSERVIETTUI_TRACE=0 to compile every probe
+// out of the library.
+#ifndef SERVIETTUI_TRACE
+#define SERVIETTUI_TRACE 1
+#endif
+
+#if SERVIETTUI_TRACE
+// name must be a string literal: only the pointer is stored.
+void traceSpan(const char* name, Uint64 start, Uint64 end);
+void traceCounter(const char* name, Uint64 value);
+
+struct TraceScope {
+    const char* name;
+    Uint64 start;
+    explicit TraceScope(const char* n) : name(n), start(SDL_GetPerformanceCounter()) {}
+    ~TraceScope() { traceSpan(name, start, SDL_GetPerformanceCounter()); }
+};
+
+#define TRACE_CONCAT2(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT2(a, b)
+#define TRACE_SCOPE(name) TraceScope TRACE_CONCAT(traceScope, __LINE__)(name)
+#define TRACE_SPAN(name, start) traceSpan(name, start, SDL_GetPerformanceCounter())
+#define TRACE_COUNTER(name, value) traceCounter(name, Uint64(value))
+#else
+#define TRACE_SCOPE(name) ((void)0)
+#define TRACE_SPAN(name, start) ((void)0)
+#define TRACE_COUNTER(name, value) ((void)0)
+#endif
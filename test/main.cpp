@@ -8,15 +8,19 @@ std::string myTextFieldText = "";
 
 void AnotherView() {
     Text("Another View");
+    Paragraph("A Paragraph wraps its text to the width of the window, so it can hold a sentence or two that would not fit on one line.", TextAlign::Center);
     Button("Click Me", []() {
         std::cout << "Button Clicked!" << std::endl;
     });
     Toggle("Show image below", imageVisible);
     if (imageVisible) {
-        Image("Image.png", 256, 256);
+        Image("Image.png", 128, 128);
     } else {
         Text("Image is hidden");
     }
+    Button("Back", []() {
+        PopView();
+    });
 }
 
 void ContentView() {
@@ -43,8 +47,9 @@ void ContentView() {
     });
 
     Button("Open another View", []() {
-        NewView(AnotherView);
+        PushView(AnotherView);
     });
+    PrefetchView(AnotherView);
 }
 
 int main() {